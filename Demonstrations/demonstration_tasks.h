@@ -115,25 +115,15 @@ the message queue becomes full and Sender Task gets put to sleep.
 At this stage, the message queue is half full with the destination as Receiver
 Task 1, and half full with the destination as Receiver Task 2. 
 
-Receiver Task 1 then reads a message which notifies the Sender Task that there
-is a space in the message queue available. Receiver Task 1 then gets made to 
-wait until the Sender Task has sent another message, after which it reads 
-another message. This repeats for both the Receiver Task 1 and Receiver Task 2
-until all messages have been sent. 
-
-The output will not be in the same order as the messages were sent. This is 
-because the OS_itcRead() function simply finds the first message meant for a 
-task in the message queue. When Receiver Task 1 reads a message, a space at the 
-start of the queue becomes available, therefore the next message added to the 
-message queue will be at the front - of which the destination will be for 
-Receiver Task 2. Hence, any messages for Receiver Task sent before the message
-queue first gets full, will be read and outputted after all messages sent
-after it was first put to sleep.
-
-This is an area of improvement for the ITC system. Ideally, it should use a 
-priority queue with the messages having different priorities, but I had to be 
-realistic about implementing this as I was running out of time in the 
-assignment.
+Receiver Task 1 then drains all of its messages with OS_ITCDrain(), which 
+notifies the Sender Task once that there is space in the message queue 
+available. The Sender Task sends more messages for Receiver Task 2, which then
+drains its mailbox in the same way. This repeats until all messages have been 
+sent. 
+
+Each receiver task has its own mailbox in the message queue, so each receiver 
+outputs its messages in the same order in which they were sent to it, and 
+sending a message only wakes the receiver it is meant for.
 */
 //#define DEMO_QUEUE_FULL
 
@@ -59,26 +59,30 @@ static void DemoITCQueueFullTask(void const* const args)
 static void DemoITCQueueFullReceiverTask1(void const* const args) 
 {
     LOG(LOG_LVL_TRACE, "Reciever Task 1 Start\n");
-    void* data;
+    void* data[ITC_MAX_MSGS];
+    uint32_t n;
     
-    while (OS_ITCHasMsg(&_demoQueueFullQueue))
+    while ((n = OS_ITCDrain(&_demoQueueFullQueue, data, ITC_MAX_MSGS)) > 0)
     {
-        //LOG(LOG_LVL_MSG, "Receiver Task 1 reading..\n");
-        
-        OS_ITCReadMsg(&_demoQueueFullQueue, &data);
-        LOG_OUTPUT("Receiver Task 1: %d\n", (uint32_t)data);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            LOG_OUTPUT("Receiver Task 1: %d\n", (uint32_t)data[i]);
+        }
     }
 }
 
 static void DemoITCQueueFullReceiverTask2(void const* const args) 
 {
     LOG(LOG_LVL_TRACE, "Reciever Task 2 Start\n");
-    void* data;
+    void* data[ITC_MAX_MSGS];
+    uint32_t n;
     
-    while (OS_ITCHasMsg(&_demoQueueFullQueue))
+    while ((n = OS_ITCDrain(&_demoQueueFullQueue, data, ITC_MAX_MSGS)) > 0)
     {
-        OS_ITCReadMsg(&_demoQueueFullQueue, &data);
-        LOG_OUTPUT("Receiver Task 2: %d\n", (uint32_t)data);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            LOG_OUTPUT("Receiver Task 2: %d\n", (uint32_t)data[i]);
+        }
     }
 }
 #endif
@@ -0,0 +1,76 @@
+#include "arena.h"
+
+#include "os.h"
+#include "os_internal.h"
+#include "memory.h"
+
+void OS_InitArena(OS_arena_t* const arena, void* const region, const size_t size)
+{
+    arena->base = (char* )region;
+    arena->size = size;
+    arena->offset = 0;
+    arena->peak = 0;
+    arena->pool = 0;
+}
+
+void OS_InitArenaFromPool(OS_arena_t* const arena, OS_mempool_t* const pool)
+{
+    OS_InitArena(arena, OS_Malloc(pool), pool->blockSz);
+    arena->pool = pool;
+}
+
+void* OS_ArenaAlloc(OS_arena_t* const arena, const size_t bytes)
+{
+    // Align the address rather than the offset, as the region itself may not 
+    // be aligned.
+    uintptr_t addr = (uintptr_t)arena->base + arena->offset;
+    size_t padding = (ARENA_ALIGN - (addr & (ARENA_ALIGN - 1))) & (ARENA_ALIGN - 1);
+    
+    if (bytes > arena->size - arena->offset || padding > arena->size - arena->offset - bytes)
+    {
+        return 0;
+    }
+    
+    void* ptr = arena->base + arena->offset + padding;
+    
+    arena->offset += padding + bytes;
+    if (arena->offset > arena->peak)
+    {
+        arena->peak = arena->offset;
+    }
+    
+    return ptr;
+}
+
+void OS_ArenaReset(OS_arena_t* const arena)
+{
+    arena->offset = 0;
+}
+
+OS_arenaMark_t OS_ArenaMark(OS_arena_t* const arena)
+{
+    return arena->offset;
+}
+
+void OS_ArenaRewind(OS_arena_t* const arena, const OS_arenaMark_t mark)
+{
+    // A mark can only move the arena back.
+    ASSERT(mark <= arena->offset);
+    arena->offset = mark;
+}
+
+size_t OS_ArenaGetUsed(const OS_arena_t* const arena)
+{
+    return arena->offset;
+}
+
+void OS_ArenaRelease(OS_arena_t* const arena)
+{
+    ASSERT(arena->pool);
+    
+    OS_Dalloc(arena->pool, arena->base);
+    arena->base = 0;
+    arena->size = 0;
+    arena->offset = 0;
+    arena->pool = 0;
+}
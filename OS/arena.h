@@ -0,0 +1,109 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+
+// Every allocation from an arena is aligned to ARENA_ALIGN bytes.
+#define ARENA_ALIGN  8
+
+/*
+An arena allocates by moving a pointer through a single region of memory, and 
+frees everything it has allocated at once when it is reset. Individual 
+allocations cannot be freed, but the arena can be rewound to a mark taken 
+earlier, freeing only what was allocated since. Marks may be nested, and must 
+be rewound in the reverse order they were taken.
+
+An arena has no lock, so it must only be used by the task that owns it.
+*/
+
+/**
+* @brief This structure contains an arena. It must be initialised with 
+*   OS_InitArena() or OS_InitArenaFromPool() before use.
+*/
+typedef struct s_Arena
+{
+    // The region allocations are made from, and its size in bytes.
+    char*   base;
+    size_t  size;
+    
+    // The offset of the first free byte in the region.
+    size_t  offset;
+    
+    // The highest offset reached since the arena was initialised, to help size
+    // the region.
+    size_t  peak;
+    
+    // The pool the region was allocated from, or 0 if it was given directly.
+    OS_mempool_t*  pool;
+} OS_arena_t;
+
+/**
+* @brief A position in an arena, returned by OS_ArenaMark().
+*/
+typedef size_t OS_arenaMark_t;
+
+/**
+* @brief Initialise an arena over a statically allocated region of memory.
+* @param arena Pointer to the arena to initialise.
+* @param region The region to allocate from.
+* @param size The size of the region in bytes.
+*/
+void OS_InitArena(OS_arena_t* const arena, void* const region, const size_t size);
+
+/**
+* @brief Initialise an arena over a block allocated from a memory pool. If no 
+*   block is free, the calling task waits for one. The block is returned to the
+*   pool by OS_ArenaRelease().
+* @param arena Pointer to the arena to initialise.
+* @param pool Pointer to the pool.
+*/
+void OS_InitArenaFromPool(OS_arena_t* const arena, OS_mempool_t* const pool);
+
+/**
+* @brief Allocate memory from an arena.
+* @param arena Pointer to the arena.
+* @param bytes The size required.
+* @return Pointer to the memory, aligned to ARENA_ALIGN bytes.
+* @return 0 if there is not enough space left in the arena.
+*/
+void* OS_ArenaAlloc(OS_arena_t* const arena, const size_t bytes);
+
+/**
+* @brief Free everything allocated from an arena.
+* @param arena Pointer to the arena.
+*/
+void OS_ArenaReset(OS_arena_t* const arena);
+
+/**
+* @brief Take a mark of the current position in an arena.
+* @param arena Pointer to the arena.
+* @return The mark, to be given to OS_ArenaRewind().
+*/
+OS_arenaMark_t OS_ArenaMark(OS_arena_t* const arena);
+
+/**
+* @brief Free everything allocated from an arena since a mark was taken. Any 
+*   marks taken after it are no longer valid.
+* @param arena Pointer to the arena.
+* @param mark The mark returned by OS_ArenaMark().
+*/
+void OS_ArenaRewind(OS_arena_t* const arena, const OS_arenaMark_t mark);
+
+/**
+* @brief Returns the number of bytes currently allocated from an arena, 
+*   including alignment padding.
+* @param arena Pointer to the arena.
+*/
+size_t OS_ArenaGetUsed(const OS_arena_t* const arena);
+
+/**
+* @brief Return the region of an arena initialised with OS_InitArenaFromPool()
+*   to its pool. The arena must not be used again until it is reinitialised.
+* @param arena Pointer to the arena.
+*/
+void OS_ArenaRelease(OS_arena_t* const arena);
+
+#endif  // ARENA_H
@@ -0,0 +1,99 @@
+#include "bitmap_pool.h"
+
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+void OS_InitBitmapPool(OS_bitmapPool_t* const pool,
+                         const size_t blockSz,
+                         const uint32_t nBlocks,
+                         void* const storage,
+                         uint32_t* const bitmap)
+{
+    ASSERT(blockSz > 0 && nBlocks > 0);
+    
+    pool->start = (uint8_t* )storage;
+    pool->end = pool->start + blockSz * nBlocks;
+    pool->blockSz = blockSz;
+    pool->nBlocks = nBlocks;
+    pool->bitmap = bitmap;
+    pool->nWords = OS_BITMAP_POOL_WORDS(nBlocks);
+    pool->nFree = nBlocks;
+    
+    // Mark every block free. The bits past the last block in the last word are
+    // left clear so they are never allocated.
+    for (uint32_t i = 0; i < pool->nWords; i++)
+    {
+        bitmap[i] = 0xFFFFFFFF;
+    }
+    
+    if (nBlocks % 32)
+    {
+        bitmap[pool->nWords - 1] = ~(0xFFFFFFFF >> (nBlocks % 32));
+    }
+}
+
+void* OS_BitmapPoolAlloc(OS_bitmapPool_t* const pool)
+{
+    for (uint32_t i = 0; i < pool->nWords; i++)
+    {
+        volatile uint32_t* word = &pool->bitmap[i];
+        uint32_t bits;
+        uint32_t bit;
+        
+        // Clear the first set bit of the word. If another task or handler 
+        // claims blocks from it first, retry with what is left.
+        do
+        {
+            bits = __LDREXW((uint32_t* )word);
+            if (!bits)
+            {
+                __CLREX();
+                break;
+            }
+            
+            bit = __CLZ(bits);
+        } while (__STREXW(bits & ~(0x80000000 >> bit), (uint32_t* )word));
+        
+        if (bits)
+        {
+            _OS_AtomicAdd(&pool->nFree, (uint32_t)-1);
+            return pool->start + (i * 32 + bit) * pool->blockSz;
+        }
+    }
+    
+    return 0;
+}
+
+void OS_BitmapPoolFree(OS_bitmapPool_t* const pool, void* const ptr)
+{
+    ASSERT(OS_BitmapPoolOwns(pool, ptr));
+    
+    uint32_t index = ((uint8_t* )ptr - pool->start) / pool->blockSz;
+    volatile uint32_t* word = &pool->bitmap[index / 32];
+    uint32_t mask = 0x80000000 >> (index % 32);
+    uint32_t bits;
+    
+    do
+    {
+        bits = __LDREXW((uint32_t* )word);
+        
+        // Catch double frees.
+        ASSERT(!(bits & mask));
+    } while (__STREXW(bits | mask, (uint32_t* )word));
+    
+    _OS_AtomicAdd(&pool->nFree, 1);
+}
+
+uint32_t OS_BitmapPoolOwns(const OS_bitmapPool_t* const pool, const void* const ptr)
+{
+    const uint8_t* p = (const uint8_t* )ptr;
+    
+    return (p >= pool->start && p < pool->end && (p - pool->start) % pool->blockSz == 0);
+}
+
+uint32_t OS_BitmapPoolGetFree(const OS_bitmapPool_t* const pool)
+{
+    return pool->nFree;
+}
@@ -0,0 +1,90 @@
+#ifndef BITMAP_POOL_H
+#define BITMAP_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+A bitmap pool allocates fixed size blocks like OS_mempool_t, but keeps which 
+blocks are free in a separate bitmap rather than in the blocks themselves. 
+Blocks may therefore be any size, down to a single byte, and the storage array 
+holds nothing but the blocks.
+
+Allocation finds the first free block with a count leading zeros instruction on
+each word of the bitmap, and claims it with LDREX/STREX, so the pool needs no 
+lock and may be used from interrupt handlers. Allocation never waits; it fails 
+if the pool is empty.
+*/
+
+/* The number of bitmap words needed for a pool of n blocks. */
+#define OS_BITMAP_POOL_WORDS(n) (((n) + 31) / 32)
+
+/**
+* @brief This structure contains a bitmap pool. It must be initialised with
+*   OS_InitBitmapPool() before use.
+*/
+typedef struct s_BitmapPool
+{
+    // The storage array, and one past its last byte.
+    uint8_t*  start;
+    uint8_t*  end;
+    
+    size_t    blockSz;
+    uint32_t  nBlocks;
+    
+    // Bit 31 - (i % 32) of word i / 32 is set if block i is free.
+    volatile uint32_t*  bitmap;
+    uint32_t  nWords;
+    
+    // The number of free blocks.
+    volatile uint32_t  nFree;
+} OS_bitmapPool_t;
+
+/**
+* @brief Initialise a bitmap pool with every block free.
+* @param pool Pointer to the pool to initialise.
+* @param blockSz The size of each block in bytes.
+* @param nBlocks The number of blocks.
+* @param storage A statically allocated array of blockSz * nBlocks bytes.
+* @param bitmap A statically allocated array of OS_BITMAP_POOL_WORDS(nBlocks) 
+*   words.
+*/
+void OS_InitBitmapPool(OS_bitmapPool_t* const pool,
+                         const size_t blockSz,
+                         const uint32_t nBlocks,
+                         void* const storage,
+                         uint32_t* const bitmap);
+
+/**
+* @brief Allocate a block from a bitmap pool. This may be called from an 
+*   interrupt handler.
+* @param pool Pointer to the pool.
+* @return Pointer to the block.
+* @return 0 if no block is free.
+*/
+void* OS_BitmapPoolAlloc(OS_bitmapPool_t* const pool);
+
+/**
+* @brief Free a block allocated from a bitmap pool. This may be called from an
+*   interrupt handler.
+* @param pool Pointer to the pool.
+* @param ptr Pointer to the block.
+*/
+void OS_BitmapPoolFree(OS_bitmapPool_t* const pool, void* const ptr);
+
+/**
+* @brief Check whether a pointer is the start of a block of a bitmap pool, in 
+*   constant time.
+* @param pool Pointer to the pool.
+* @param ptr The pointer to check.
+* @return 1 if it is, 0 otherwise.
+*/
+uint32_t OS_BitmapPoolOwns(const OS_bitmapPool_t* const pool, const void* const ptr);
+
+/**
+* @brief Returns the number of free blocks in a bitmap pool.
+* @param pool Pointer to the pool.
+*/
+uint32_t OS_BitmapPoolGetFree(const OS_bitmapPool_t* const pool);
+
+#endif  // BITMAP_POOL_H
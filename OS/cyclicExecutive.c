@@ -0,0 +1,172 @@
+#include "cyclicExecutive.h"
+
+#include "stm32f3xx.h"
+
+#include "os_internal.h"
+#include "tcb_priority_queue.h"
+#include "debugTools.h"
+
+/*
+Tasks are not held in any running tasks queue. Whether the task of the current
+slot may run is decided entirely by _slotDone, its TASK_STATE_EXIT flag, and 
+whether it is currently held in an object's waiting tasks queue, which is 
+recorded in its queue field.
+*/
+
+static const OS_dispatchEntry_t*  _table = 0;
+static size_t                     _nEntries = 0;
+static uint32_t                   _hyperperiod = 0;
+
+/* The number of ticks into the hyperperiod, and the current entry. */
+static volatile uint32_t  _frameTick = 0;
+static volatile uint32_t  _entry = 0;
+
+/* Set to 1 once the task of the current slot has finished its work. */
+static volatile uint32_t  _slotDone = 0;
+
+static volatile uint32_t  _nOverruns = 0;
+static volatile uint32_t  _lastOverrun = 0;
+
+/* Scheduler callback function prototypes. */
+static const OS_TCB_t*  CE_SchedulerCallback(void); 
+static uint32_t  CE_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority);
+static void  CE_TaskExitCallback(OS_TCB_t* const task);
+static void  CE_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue, OS_TCB_t* const tcb);
+static void  CE_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue);
+static void  CE_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time);
+static void  CE_TickCallback(const uint32_t ticks);
+
+OS_Scheduler_t const cyclicExecutiveScheduler = 
+{
+    .preemptive        = OS_PREEMPTIVE_SCHEDULING,
+    .SchedulerCallback = CE_SchedulerCallback,
+    .AddTaskCallback   = CE_AddTaskCallback,
+    .TaskExitCallback  = CE_TaskExitCallback,
+    .WaitCallback      = CE_TaskWaitCallback,
+    .NotifyCallback    = CE_TaskNotifyCallback,
+    .SleepCallback     = CE_TaskSleepCallback,
+    .TickCallback      = CE_TickCallback
+};
+
+void OS_InitCyclicExecutive(const OS_dispatchEntry_t* const table,
+                              const size_t nEntries,
+                              const uint32_t hyperperiod)
+{
+    ASSERT(nEntries > 0);
+    ASSERT(table[0].offset == 0);
+    for (uint32_t i = 1; i < nEntries; i++)
+    {
+        ASSERT(table[i].offset > table[i - 1].offset);
+        ASSERT(table[i].offset < hyperperiod);
+    }
+    
+    _table = table;
+    _nEntries = nEntries;
+    _hyperperiod = hyperperiod;
+    _frameTick = 0;
+    _entry = 0;
+    _slotDone = 0;
+    _nOverruns = 0;
+}
+
+uint32_t OS_CEGetOverrunCount(void)
+{
+    return _nOverruns;
+}
+
+uint32_t OS_CEGetLastOverrun(void)
+{
+    return _lastOverrun;
+}
+
+const OS_TCB_t* CE_SchedulerCallback(void)
+{
+    OS_TCB_t* tcb = _table[_entry].tcb;
+    
+    if (!tcb || _slotDone || (tcb->state & TASK_STATE_EXIT))
+    {
+        return OS_idleTCB_p;
+    }
+    
+    if (tcb->state & TASK_STATE_YIELD)
+    {
+        // The task has finished its work for this slot.
+        tcb->state &= ~TASK_STATE_YIELD;
+        _slotDone = 1;
+        return OS_idleTCB_p;
+    }
+    
+    if (tcb->queue)
+    {
+        // The task is waiting in an object's waiting tasks queue.
+        return OS_idleTCB_p;
+    }
+    
+    return tcb;
+}
+
+uint32_t CE_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority)
+{
+    // The task only runs when the dispatch table says so. Its priority is only
+    // used to order it in objects' waiting tasks queues.
+    newTask->priority = priority;
+    return OS_ADD_TASK_OK;
+}
+
+void CE_TaskExitCallback(OS_TCB_t* const task)
+{
+    task->state |= TASK_STATE_EXIT;
+    _slotDone = 1;
+}
+
+void CE_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue,
+                           OS_TCB_t* const tcb)
+{
+    OS_TCBPriorityQueueInsert(waitingTaskQueue, tcb);
+    
+    // Set the PendSV to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void CE_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue)
+{
+    // Removing the task from the waiting tasks queue is enough for it to be
+    // run again if it is in the current slot.
+    OS_TCBPriorityQueueExtract(waitingTaskQueue);
+    
+    // Set the PendSV bit to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void CE_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time)
+{
+    // There is no sleeping in a time-triggered schedule; the task next runs in
+    // its next slot. Sleeping is treated as finishing the slot's work.
+    tcb->state &= ~TASK_STATE_SLEEP;
+    tcb->data = 0;
+    
+    OS_Yield();
+}
+
+/* Moves on to the next entry when its offset is reached, counting an overrun if
+the task of the slot that is ending had not finished its work. */
+void CE_TickCallback(const uint32_t ticks)
+{
+    _frameTick = (_frameTick + 1) % _hyperperiod;
+    
+    uint32_t next = (_entry + 1) % _nEntries;
+    if (_table[next].offset != _frameTick)
+    {
+        return;
+    }
+    
+    OS_TCB_t* tcb = _table[_entry].tcb;
+    if (tcb && !_slotDone && !(tcb->state & TASK_STATE_EXIT))
+    {
+        _nOverruns++;
+        _lastOverrun = _entry;
+    }
+    
+    _entry = next;
+    _slotDone = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef CYCLIC_EXECUTIVE
+#define CYCLIC_EXECUTIVE
+
+#include "os.h"
+
+/*
+The cyclic executive is a time-triggered scheduler which makes no scheduling
+decisions at runtime. It is given a dispatch table of (offset, task) entries 
+covering one hyperperiod, sorted by offset, with the first entry at offset 0. 
+Each entry owns the slot from its offset until the offset of the next entry, 
+and the table repeats every hyperperiod ticks.
+
+The system tick simply moves on to the next entry when its offset is reached, 
+and the scheduler returns the task in the current entry. The same task may 
+appear in several entries. An entry with a task of 0 is an idle slot.
+
+A task marks the end of its work for a slot by calling OS_Yield(), or 
+OS_Sleep(), which is treated the same way, and is not run again until its next 
+slot. If a slot ends before its task has done so, it is counted as an overrun.
+Overruns are not corrected, only reported; the task simply continues in its 
+next slot.
+
+Mutexes, semaphores and ITC queues still work. If the task of the current slot
+has to wait, the processor idles until it is notified or the slot ends.
+*/
+
+/**
+* @brief This structure contains a single entry in the dispatch table.
+*/
+typedef struct s_DispatchEntry
+{
+    // The number of ticks from the start of the hyperperiod at which the 
+    // entry's slot starts.
+    uint32_t offset;
+    
+    // The task to run during the slot, or 0 for an idle slot.
+    OS_TCB_t* tcb;
+} OS_dispatchEntry_t;
+
+extern OS_Scheduler_t const cyclicExecutiveScheduler;
+
+/**
+* @brief Initialise the cyclic executive. This must be called before 
+*   OS_Start(). Each task in the table must still be added with OS_AddTask(),
+*   which sets the priority it holds in objects' waiting tasks queues.
+* @param table Pointer to the dispatch table. The table is not copied, so 
+*   should be declared static const.
+* @param nEntries The number of entries in the table.
+* @param hyperperiod The length of the table in ticks. All offsets must be less
+*   than this.
+*/
+void OS_InitCyclicExecutive(const OS_dispatchEntry_t* const table,
+                              const size_t nEntries,
+                              const uint32_t hyperperiod);
+
+/**
+* @brief Returns the number of slots that have ended before their task called 
+*   OS_Yield().
+*/
+uint32_t OS_CEGetOverrunCount(void);
+
+/**
+* @brief Returns the index in the dispatch table of the entry that most recently
+*   overran. This is only meaningful if OS_CEGetOverrunCount() is not 0.
+*/
+uint32_t OS_CEGetLastOverrun(void);
+
+#endif  // CYCLIC_EXECUTIVE
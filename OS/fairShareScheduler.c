@@ -0,0 +1,240 @@
+#include "fairShareScheduler.h"
+
+#include "stm32f3xx.h"
+
+#include "tcb_priority_queue.h"
+#include "debugTools.h"
+
+/*
+Each task in the class has a slot in the _tasks, _strides and _passes arrays,
+and a flag in _runnable which is cleared whilst the task is sleeping or waiting. 
+Sleeping tasks are also held in _sleepingTasksQueue, exactly as in the 
+fixed-priority scheduler. The class holds at most FSS_MAX_TASKS tasks, so the 
+arrays are simply searched.
+
+Pass values are compared by their signed difference, so that they may wrap 
+around.
+*/
+
+/* The stride of a task of weight 1. */
+#define FSS_STRIDE_1 (1UL << 16)
+
+static OS_TCB_t*  _tasks[FSS_MAX_TASKS];
+static uint32_t   _strides[FSS_MAX_TASKS];
+static uint32_t   _passes[FSS_MAX_TASKS];
+static uint32_t   _runnable[FSS_MAX_TASKS];
+
+/* The slot of the task most recently chosen by the scheduler callback. */
+static uint32_t   _current = 0;
+
+static OS_tcbPriorityQueue_t  _sleepingTasksQueue;
+static OS_TCB_t*              _sleepingTasks[FSS_MAX_TASKS];
+
+/* Scheduler callback function prototypes. */
+static const OS_TCB_t*  FSS_SchedulerCallback(void); 
+static uint32_t  FSS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t weight);
+static void  FSS_TaskExitCallback(OS_TCB_t* const task);
+static void  FSS_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue, OS_TCB_t* const tcb);
+static void  FSS_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue);
+static void  FSS_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time);
+static void  FSS_TickCallback(const uint32_t ticks);
+
+OS_Scheduler_t const fairShareScheduler = 
+{
+    .preemptive        = OS_PREEMPTIVE_SCHEDULING,
+    .SchedulerCallback = FSS_SchedulerCallback,
+    .AddTaskCallback   = FSS_AddTaskCallback,
+    .TaskExitCallback  = FSS_TaskExitCallback,
+    .WaitCallback      = FSS_TaskWaitCallback,
+    .NotifyCallback    = FSS_TaskNotifyCallback,
+    .SleepCallback     = FSS_TaskSleepCallback,
+    .TickCallback      = FSS_TickCallback
+};
+
+void OS_InitFSS(void)
+{
+    for (uint32_t i = 0; i < FSS_MAX_TASKS; i++)
+    {
+        _tasks[i] = 0;
+        _runnable[i] = 0;
+    }
+    
+    OS_InitTCBPriorityQueue(&_sleepingTasksQueue, _sleepingTasks, FSS_MAX_TASKS, TCBPQ_ORDER_BY_DATA);
+}
+
+/* This function returns the slot of a task in the class, or -1 if the task does
+not belong to the class. */
+static int32_t FindTask(const OS_TCB_t* const tcb)
+{
+    for (uint32_t i = 0; i < FSS_MAX_TASKS; i++)
+    {
+        if (_tasks[i] == tcb)
+        {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+/* This function returns the slot of the runnable task with the lowest pass 
+value, or -1 if no task is runnable. The current task wins ties, to avoid 
+switching between tasks more often than necessary. */
+static int32_t MinimumPass(void)
+{
+    int32_t min = -1;
+    
+    if (_tasks[_current] && _runnable[_current])
+    {
+        min = _current;
+    }
+    
+    for (uint32_t i = 0; i < FSS_MAX_TASKS; i++)
+    {
+        if (!_tasks[i] || !_runnable[i])
+        {
+            continue;
+        }
+        
+        if (min == -1 || (int32_t)(_passes[i] - _passes[min]) < 0)
+        {
+            min = i;
+        }
+    }
+    
+    return min;
+}
+
+/* This function makes a task runnable again. Its pass is brought up to the 
+lowest pass of the other runnable tasks, so time spent not runnable is not
+counted in its favour. */
+static void MakeRunnable(const uint32_t slot)
+{
+    int32_t min = MinimumPass();
+    
+    if (min != -1 && (int32_t)(_passes[slot] - _passes[min]) < 0)
+    {
+        _passes[slot] = _passes[min];
+    }
+    
+    _runnable[slot] = 1;
+}
+
+/* This function moves tasks whose sleep time has elapsed out of 
+_sleepingTasksQueue and makes them runnable again. */
+static void UpdateSleepingTasks(void)
+{
+    uint32_t ticks = OS_ElapsedTicks();
+    OS_TCB_t* extracted = 0;
+    
+    while (!OS_TCBPriorityQueueEmpty(&_sleepingTasksQueue) && 
+           ticks > OS_TCBPriorityQueuePeek(&_sleepingTasksQueue)->data)
+    {
+        extracted = OS_TCBPriorityQueueExtract(&_sleepingTasksQueue);
+        extracted->data = 0;  // clear any data related to sleeping
+        
+        int32_t slot = FindTask(extracted);
+        if (slot != -1)
+        {
+            MakeRunnable(slot);
+        }
+    }
+}
+
+const OS_TCB_t* FSS_SchedulerCallback(void)
+{
+    UpdateSleepingTasks();
+    
+    int32_t slot = MinimumPass();
+    if (slot == -1)
+    {
+        return OS_idleTCB_p;
+    }
+    
+    _current = slot;
+    return _tasks[slot];
+}
+
+uint32_t FSS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t weight)
+{
+    int32_t slot = FindTask(0);
+    if (slot == -1)
+    {
+        return OS_ADD_TASK_ERR_FULL;
+    }
+    
+    newTask->priority = OS_SCHEDULER_PRIORITY_LVL_NONE;
+    
+    _tasks[slot] = newTask;
+    _strides[slot] = FSS_STRIDE_1 / (weight ? weight : 1);
+    _passes[slot] = 0;
+    MakeRunnable(slot);
+    
+    return OS_ADD_TASK_OK;
+}
+
+void FSS_TaskExitCallback(OS_TCB_t* const task)
+{
+    int32_t slot = FindTask(task);
+    if (slot != -1)
+    {
+        _tasks[slot] = 0;
+        _runnable[slot] = 0;
+    }
+}
+
+void FSS_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue,
+                            OS_TCB_t* const tcb)
+{
+    int32_t slot = FindTask(tcb);
+    if (slot != -1)
+    {
+        _runnable[slot] = 0;
+    }
+    
+    OS_TCBPriorityQueueInsert(waitingTaskQueue, tcb);
+    
+    // Set the PendSV to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void FSS_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue)
+{
+    OS_TCB_t* tcb = OS_TCBPriorityQueueExtract(waitingTaskQueue);
+    if (!tcb)
+    {
+        return;
+    }
+    
+    int32_t slot = FindTask(tcb);
+    if (slot != -1)
+    {
+        MakeRunnable(slot);
+    }
+    
+    // Set the PendSV bit to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void FSS_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time)
+{
+    int32_t slot = FindTask(tcb);
+    if (slot != -1)
+    {
+        _runnable[slot] = 0;
+    }
+    
+    OS_TCBPriorityQueueInsert(&_sleepingTasksQueue, tcb);
+    
+    OS_Yield();
+}
+
+/* The task that was running for the tick that has just elapsed is charged for 
+it by advancing its pass by its stride. */
+void FSS_TickCallback(const uint32_t ticks)
+{
+    if (_tasks[_current] && _tasks[_current] == OS_CurrentTCB())
+    {
+        _passes[_current] += _strides[_current];
+    }
+}
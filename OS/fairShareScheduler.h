@@ -0,0 +1,38 @@
+#ifndef FAIR_SHARE_SCHEDULER
+#define FAIR_SHARE_SCHEDULER
+
+#include "os.h"
+
+/*
+The fair-share scheduler is a proportional-share scheduling class, intended to 
+be installed below the fixed-priority scheduler with OS_AddSchedulingClass(). 
+It only runs tasks when the class above it has nothing to run, and splits that 
+remaining processor time between its tasks in proportion to their weights. For
+example, a task of weight 2 receives twice as many ticks as a task of weight 1.
+
+It uses stride scheduling. Each task has a stride, inversely proportional to 
+its weight, and a pass value. The runnable task with the lowest pass value is 
+always chosen, and each tick it runs for advances its pass by its stride. A task
+that becomes runnable again after sleeping or waiting has its pass brought up
+to that of the other runnable tasks, so it cannot build up credit whilst it is
+not runnable.
+
+Tasks are added to this class by calling OS_SetSchedulingClass() with the index
+returned by OS_AddSchedulingClass(), and then OS_AddTask(). The priority 
+argument to OS_AddTask() is used as the task's weight instead; a weight of 0 is
+treated as 1. The task's priority is set to OS_SCHEDULER_PRIORITY_LVL_NONE, so 
+that in an object's waiting tasks queue it is always behind tasks from the 
+fixed-priority scheduler.
+*/
+
+#define FSS_MAX_TASKS MAX_TASKS
+
+extern OS_Scheduler_t const fairShareScheduler;
+
+/**
+* @brief Initialise the fair-share scheduler. This must be called before 
+*   OS_Start().
+*/
+void OS_InitFSS(void);
+
+#endif  // FAIR_SHARE_SCHEDULER
@@ -1,7 +1,9 @@
 #include "fixedPriorityScheduler.h"
 
 #include "stm32f3xx.h"
+#include "cmsis_armcc.h"
 
+#include "os_internal.h"
 #include "tcb_priority_queue.h"
 #include "debugTools.h"
 
@@ -29,6 +31,12 @@ the highest-priority tasks are in is not guarenteed. For example, if three tasks
 were added in order 1, 2, 3, and all had priority level 1, then it is not 
 certain that they will execute in that order. The _sleepingTasksQueue ensures 
 the task with the lowest time left to sleep is always at the front. 
+
+Sporadic servers are registered in _sporadicServers. On every tick, each server
+is charged for the tick if it was the running task, its due replenishments are 
+applied, and it is suspended or resumed accordingly. A server is suspended by 
+moving it from _runningTasksQueue into its own waiting tasks queue, exactly as
+if it had called OS_Wait(), and is resumed by notifying that queue.
 */
 
 
@@ -40,13 +48,26 @@ _sleepingTasksQueue. */
 static OS_TCB_t*  _runningTasks[MAX_TASKS];
 static OS_TCB_t*  _sleepingTasks[MAX_TASKS];
 
+/* All admitted tasks that have declared their timing. These make up the task 
+set that is analysed each time a new task is added, or the priority of one of
+them is changed. Tasks at OS_SCHEDULER_PRIORITY_LVL_NONE are only run when 
+nothing else can be, so have no guarantee to analyse and are left out. */
+static OS_TCB_t*  _realTimeTasks[MAX_TASKS];
+static uint32_t   _nRealTimeTasks = 0;
+
+/* The registered sporadic servers. */
+static OS_sporadicServer_t*  _sporadicServers[FPS_MAX_SPORADIC_SERVERS];
+static uint32_t              _nSporadicServers = 0;
+
 /* Scheduler callback function prototypes. */
 static const OS_TCB_t*  FPS_SchedulerCallback(void); 
-static void  FPS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority);
+static uint32_t  FPS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority);
 static void  FPS_TaskExitCallback(OS_TCB_t* const task);
 static void  FPS_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue, OS_TCB_t* const tcb);
 static void  FPS_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue);
 static void  FPS_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time);
+static void  FPS_TickCallback(const uint32_t ticks);
+static uint32_t  FPS_SetPriorityCallback(OS_TCB_t* const tcb, const uint32_t priority);
 
 OS_Scheduler_t const fixedPriorityScheduler = 
 {
@@ -56,7 +77,9 @@ OS_Scheduler_t const fixedPriorityScheduler =
     .TaskExitCallback  = FPS_TaskExitCallback,
     .WaitCallback      = FPS_TaskWaitCallback,
     .NotifyCallback    = FPS_TaskNotifyCallback,
-    .SleepCallback     = FPS_TaskSleepCallback
+    .SleepCallback     = FPS_TaskSleepCallback,
+    .TickCallback      = FPS_TickCallback,
+    .SetPriorityCallback = FPS_SetPriorityCallback
 };
 
 void OS_InitFPS(void)
@@ -100,17 +123,180 @@ const OS_TCB_t* FPS_SchedulerCallback(void)
     return tcb;
 }
 
-void FPS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority)
+/* This function calculates the worst-case response time of one task in a task 
+set. The calculation stops as soon as the response time exceeds the task's 
+deadline, so the value returned is only exact if it is within the deadline. */
+static uint32_t ResponseTime(OS_TCB_t* const* const tasks, 
+                               const uint32_t nTasks, 
+                               const uint32_t index)
+{
+    const OS_TCB_t* task = tasks[index];
+    uint32_t response = task->timing.wcet;
+    uint32_t previous = 0;
+    
+    while (response != previous && response <= task->timing.deadline)
+    {
+        previous = response;
+        response = task->timing.wcet;
+        
+        for (uint32_t j = 0; j < nTasks; j++)
+        {
+            if (j == index || 
+                tasks[j]->priority > task->priority || 
+                tasks[j]->priority == OS_SCHEDULER_PRIORITY_LVL_NONE)
+            {
+                continue;
+            }
+            
+            uint32_t releases = (previous + tasks[j]->timing.period - 1) / tasks[j]->timing.period;
+            response += releases * tasks[j]->timing.wcet;
+        }
+    }
+    
+    return response;
+}
+
+/* This function determines whether a task set is schedulable, i.e. whether 
+every task in it meets its deadline with the priorities they currently have. */
+static uint32_t IsSetSchedulable(OS_TCB_t* const* const tasks, const uint32_t nTasks)
+{
+    uint32_t utilisation = 0;
+    
+    // A total utilisation above 1 can never be schedulable, and this is much
+    // cheaper to check than the response times. Utilisation is calculated in
+    // units of 1/1024.
+    for (uint32_t i = 0; i < nTasks; i++)
+    {
+        if (tasks[i]->priority != OS_SCHEDULER_PRIORITY_LVL_NONE)
+        {
+            utilisation += (tasks[i]->timing.wcet << 10) / tasks[i]->timing.period;
+        }
+    }
+    
+    if (utilisation > (1 << 10))
+    {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < nTasks; i++)
+    {
+        if (tasks[i]->priority != OS_SCHEDULER_PRIORITY_LVL_NONE &&
+            ResponseTime(tasks, nTasks, i) > tasks[i]->timing.deadline)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/* This function determines whether the admitted task set would still be 
+schedulable if the new task was added to it. */
+static uint32_t IsSchedulable(OS_TCB_t* const newTask)
+{
+    OS_TCB_t* tasks[MAX_TASKS + 1];
+    
+    for (uint32_t i = 0; i < _nRealTimeTasks; i++)
+    {
+        tasks[i] = _realTimeTasks[i];
+    }
+    tasks[_nRealTimeTasks] = newTask;
+    
+    return IsSetSchedulable(tasks, _nRealTimeTasks + 1);
+}
+
+uint32_t FPS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority)
 {
     newTask->priority = priority;
+    
+    if (OS_TCBPriorityQueueFull(&_runningTasksQueue))
+    {
+        return OS_ADD_TASK_ERR_FULL;
+    }
+    
+    if (newTask->timing.period)
+    {
+        // The analysis assumes each job completes before the next is released.
+        if (!newTask->timing.wcet || 
+            !newTask->timing.deadline ||
+            newTask->timing.deadline > newTask->timing.period)
+        {
+            return OS_ADD_TASK_ERR_INVALID;
+        }
+        
+        if (_nRealTimeTasks == MAX_TASKS || !IsSchedulable(newTask))
+        {
+            return OS_ADD_TASK_ERR_UNSCHEDULABLE;
+        }
+        
+        _realTimeTasks[_nRealTimeTasks++] = newTask;
+    }
+    
     OS_TCBPriorityQueueInsert(&_runningTasksQueue, newTask);
+    return OS_ADD_TASK_OK;
+}
+
+/* This function checks that changing the priority of a task leaves the 
+admitted task set schedulable. Only the priorities of admitted tasks affect the
+analysis, so the priority of any other task may always be changed. */
+uint32_t FPS_IsSchedulableWith(OS_TCB_t* const tcb, 
+                                 const uint32_t priority, 
+                                 const uint32_t period)
+{
+    uint32_t admitted = 0;
+    
+    for (uint32_t i = 0; i < _nRealTimeTasks; i++)
+    {
+        if (_realTimeTasks[i] == tcb)
+        {
+            admitted = 1;
+            break;
+        }
+    }
+    
+    if (!admitted)
+    {
+        return 1;
+    }
+    
+    // Analyse the set with the new priority and period in place, then put the
+    // old ones back, as the caller makes the change itself if it is allowed.
+    uint32_t oldPriority = tcb->priority;
+    uint32_t oldPeriod = tcb->timing.period;
+    tcb->priority = priority;
+    tcb->timing.period = period;
+    uint32_t schedulable = IsSetSchedulable(_realTimeTasks, _nRealTimeTasks);
+    tcb->priority = oldPriority;
+    tcb->timing.period = oldPeriod;
+    
+    return schedulable;
+}
+
+static uint32_t FPS_SetPriorityCallback(OS_TCB_t* const tcb, const uint32_t priority)
+{
+    if (FPS_IsSchedulableWith(tcb, priority, tcb->timing.period))
+    {
+        return OS_SET_PRIORITY_OK;
+    }
+    
+    return OS_SET_PRIORITY_ERR_UNSCHEDULABLE;
 }
 
 void FPS_TaskExitCallback(OS_TCB_t* const task)
 {
     // Task no longer should be executed so remove it from the running tasks 
     // queue.
-    OS_TCBPriorityQueueExtract(&_runningTasksQueue);
+    OS_TCBPriorityQueueRemove(&_runningTasksQueue, task);
+    
+    // Its share of the processor is now free for other tasks to be admitted.
+    for (uint32_t i = 0; i < _nRealTimeTasks; i++)
+    {
+        if (_realTimeTasks[i] == task)
+        {
+            _realTimeTasks[i] = _realTimeTasks[--_nRealTimeTasks];
+            break;
+        }
+    }
 }
 
 void FPS_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue,
@@ -157,3 +343,219 @@ void FPS_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, cons
     OS_Yield();
 }
 
+/* This function determines whether a sporadic server has a job waiting at the
+head of its job queue. */
+static uint32_t SporadicServerHasJob(const OS_sporadicServer_t* const server)
+{
+    return server->jobs[server->jobHead].func != 0;
+}
+
+/* This function schedules a replenishment of a sporadic server's budget. The
+replenishments are stored in order of their due time. If there is no room for 
+another, the amount is merged into the latest one, which can only delay, and 
+never bring forward, the budget being returned. */
+static void PostReplenishment(OS_sporadicServer_t* const server, 
+                                const uint32_t time, 
+                                const uint32_t amount)
+{
+    if (amount == 0)
+    {
+        return;
+    }
+    
+    if (server->nReplenishments == FPS_SS_MAX_REPLENISHMENTS)
+    {
+        uint32_t last = (server->replenishmentHead + server->nReplenishments - 1) 
+                            % FPS_SS_MAX_REPLENISHMENTS;
+        server->replenishments[last].time = time;
+        server->replenishments[last].amount += amount;
+        return;
+    }
+    
+    uint32_t index = (server->replenishmentHead + server->nReplenishments) 
+                        % FPS_SS_MAX_REPLENISHMENTS;
+    server->replenishments[index].time = time;
+    server->replenishments[index].amount = amount;
+    server->nReplenishments++;
+}
+
+/* This function carries out the per-tick accounting of a sporadic server. */
+static void SporadicServerTick(OS_sporadicServer_t* const server, 
+                                 const uint32_t ticks)
+{
+    // Apply any replenishments that are due.
+    while (server->nReplenishments > 0 && 
+           (int32_t)(ticks - server->replenishments[server->replenishmentHead].time) >= 0)
+    {
+        server->budget += server->replenishments[server->replenishmentHead].amount;
+        if (server->budget > server->capacity)
+        {
+            server->budget = server->capacity;
+        }
+        
+        server->replenishmentHead = (server->replenishmentHead + 1) % FPS_SS_MAX_REPLENISHMENTS;
+        server->nReplenishments--;
+    }
+    
+    uint32_t pending = SporadicServerHasJob(server) || server->busy;
+    
+    // The server becomes active when it has work to do and budget to do it.
+    // Its replenishment time is set from the moment it becomes active.
+    if (!server->active && pending && server->budget > 0)
+    {
+        server->active = 1;
+        server->activationTime = ticks;
+        server->consumed = 0;
+    }
+    
+    // Charge the server for the tick that has just elapsed if it was running.
+    if (OS_CurrentTCB() == &server->tcb && server->budget > 0)
+    {
+        server->budget--;
+        server->consumed++;
+    }
+    
+    // The activation ends when the server runs out of work or out of budget,
+    // at which point whatever it consumed is scheduled to be replenished.
+    if (server->active && (!pending || server->budget == 0))
+    {
+        PostReplenishment(server, server->activationTime + server->period, server->consumed);
+        server->active = 0;
+    }
+    
+    if (server->budget == 0 && server->tcb.queue == &_runningTasksQueue)
+    {
+        // Out of budget, so suspend the server until it is replenished.
+        FPS_TaskWaitCallback(&server->_waitingTaskQueue, &server->tcb);
+    }
+    else if (server->budget > 0 && 
+             server->tcb.queue == &server->_waitingTaskQueue && 
+             pending)
+    {
+        // Either replenished whilst suspended, possibly part way through its
+        // last job, or a job was submitted from an interrupt handler whilst 
+        // the server was idle.
+        FPS_TaskNotifyCallback(&server->_waitingTaskQueue);
+    }
+}
+
+void FPS_TickCallback(const uint32_t ticks)
+{
+    for (uint32_t i = 0; i < _nSporadicServers; i++)
+    {
+        SporadicServerTick(_sporadicServers[i], ticks);
+    }
+}
+
+/* The task function executed by every sporadic server. It serves jobs from the
+server's job queue for as long as there are jobs and budget, and otherwise 
+waits in the server's waiting tasks queue. */
+static void SporadicServerTask(void const* const args)
+{
+    OS_sporadicServer_t* server = (OS_sporadicServer_t* )args;
+    OS_aperiodicJobSlot_t* slot;
+    OS_aperiodicJob_t func;
+    void* arg;
+    
+    while (1)
+    {
+        uint32_t checkCode = OS_GetCheckCode();
+        
+        if (!SporadicServerHasJob(server) || server->budget == 0)
+        {
+            OS_Wait(&server->_waitingTaskQueue, checkCode);
+            continue;
+        }
+        
+        slot = &server->jobs[server->jobHead];
+        func = slot->func;
+        arg = slot->arg;
+        
+        server->busy = 1;
+        slot->func = 0;
+        server->jobHead = (server->jobHead + 1) % server->nJobs;
+        
+        func(arg);
+        
+        server->busy = 0;
+    }
+}
+
+void OS_InitSporadicServer(OS_sporadicServer_t* const server,
+                             uint32_t* const stack,
+                             OS_aperiodicJobSlot_t* const jobs,
+                             const size_t nJobs,
+                             const uint32_t capacity,
+                             const uint32_t period)
+{
+    ASSERT(_nSporadicServers < FPS_MAX_SPORADIC_SERVERS);
+    ASSERT(capacity <= period);
+    
+    server->capacity = capacity;
+    server->period = period;
+    server->budget = capacity;
+    server->active = 0;
+    server->activationTime = 0;
+    server->consumed = 0;
+    server->replenishmentHead = 0;
+    server->nReplenishments = 0;
+    server->jobs = jobs;
+    server->nJobs = nJobs;
+    server->jobHead = 0;
+    server->jobTail = 0;
+    server->busy = 0;
+    
+    for (uint32_t i = 0; i < nJobs; i++)
+    {
+        jobs[i].func = 0;
+        jobs[i].arg = 0;
+    }
+    
+    OS_InitTCBPriorityQueue(&server->_waitingTaskQueue, server->_waitingTasks, 1, TCBPQ_ORDER_BY_PRIORITY);
+    OS_InitialiseTCB(&server->tcb, stack, SporadicServerTask, server);
+    
+    // The server never executes for more than its capacity in any period, so 
+    // it is analysed as a periodic task with those parameters.
+    OS_SetTaskTiming(&server->tcb, capacity, period, period);
+    
+    _sporadicServers[_nSporadicServers++] = server;
+}
+
+uint32_t OS_SporadicServerSubmit(OS_sporadicServer_t* const server,
+                                   const OS_aperiodicJob_t func,
+                                   void* const arg)
+{
+    uint32_t tail;
+    uint32_t next;
+    
+    // Reserve a slot by atomically advancing the tail. This allows jobs to be
+    // submitted from several tasks and interrupt handlers at once.
+    do 
+    {
+        tail = __LDREXW(&server->jobTail);
+        next = (tail + 1) % server->nJobs;
+        
+        if (next == server->jobHead)
+        {
+            __CLREX();
+            return 0;
+        }
+    } while (__STREXW(next, &server->jobTail));
+    
+    // The job is published by setting func last, as the server treats a slot 
+    // as empty until func is non-zero.
+    server->jobs[tail].arg = arg;
+    __DMB();
+    server->jobs[tail].func = func;
+    
+    // A task can wake the server straight away. An interrupt handler cannot 
+    // make an SVC call, so the server will be woken on the next tick instead.
+    if (__get_IPSR() == 0 && 
+        server->budget > 0 && 
+        server->tcb.queue == &server->_waitingTaskQueue)
+    {
+        OS_Notify(&server->_waitingTaskQueue);
+    }
+    
+    return 1;
+}
@@ -13,10 +13,112 @@ order they were added. To ensure tasks are executed in a specific order, take
 advantage of the priority levels.
 
 There are a maximum number of tasks that the fixed-priority scheduler can 
-manage, FPS_MAX tasks (defined in task.h). If the scheduler is full, and more 
-tasks are added using OS_Add(), they will simply not be added and not scheduled
-and executed.
+manage, MAX_TASKS (defined in task.h). If the scheduler is full, and more 
+tasks are added using OS_AddTask(), they will not be added and 
+OS_ADD_TASK_ERR_FULL is returned.
+
+Tasks may declare their worst-case execution time, period and deadline with 
+OS_SetTaskTiming() before they are added. When such a task is added, 
+response-time analysis is carried out on it and every other admitted task that
+has declared its timing. If any of them could miss its deadline, the new task 
+is not added and OS_ADD_TASK_ERR_UNSCHEDULABLE is returned. Tasks that have not
+declared their timing are not included in the analysis. A task whose timing has
+a zero wcet or deadline, or a deadline longer than its period, is not added and
+OS_ADD_TASK_ERR_INVALID is returned. Tasks at OS_SCHEDULER_PRIORITY_LVL_NONE 
+are only run when nothing else can be, so they are left out of the analysis, 
+and are only analysed once their priority is raised.
+*/
+
+/*
+Aperiodic work can be handled by a sporadic server. A sporadic server is a task,
+added to the scheduler at a (usually high) priority like any other, that serves 
+a queue of aperiodic jobs. It may only execute for 'capacity' ticks in any 
+window of 'period' ticks. Every tick the server runs is charged to its budget, 
+and when the budget is exhausted the server is suspended until it is 
+replenished. Each time the server becomes active, a replenishment of whatever it 
+consumes is scheduled for one period after it became active. This is tracked 
+on the tick path by the scheduler's tick callback.
+
+Because the server never consumes more than its capacity in any period, it can 
+be treated as an ordinary periodic task with WCET 'capacity' and period 
+'period' when analysing the schedulability of the periodic task set, while 
+still giving aperiodic jobs a high-priority response time.
+*/
+
+#define FPS_MAX_SPORADIC_SERVERS   2
+#define FPS_SS_MAX_REPLENISHMENTS  4
+
+/**
+* @brief A single aperiodic job, served by a sporadic server. 
 */
+typedef void (* OS_aperiodicJob_t)(void* const arg);
+
+/**
+* @brief This structure contains one slot in a sporadic server's job queue. A
+*   slot is empty when its func field is 0. 
+*/
+typedef struct s_AperiodicJobSlot
+{
+    OS_aperiodicJob_t volatile  func;
+    void* volatile              arg;
+} OS_aperiodicJobSlot_t;
+
+/**
+* @brief This structure contains a single pending replenishment of a sporadic
+*   server's budget.
+*/
+typedef struct s_Replenishment
+{
+    // The number of elapsed ticks at which the replenishment is due.
+    uint32_t time;
+    
+    // The number of ticks of budget to be replenished.
+    uint32_t amount;
+} OS_replenishment_t;
+
+/**
+* @brief This structure contains a single sporadic server. It must be 
+*   initialised with OS_InitSporadicServer() and then added to the scheduler 
+*   with OS_AddTask(&server->tcb, priority).
+*/
+typedef struct s_SporadicServer
+{
+    // The task that executes the aperiodic jobs.
+    OS_TCB_t  tcb;
+    
+    // The maximum number of ticks the server may execute for in any window of
+    // period ticks.
+    uint32_t  capacity;
+    uint32_t  period;
+    
+    // The number of ticks the server may currently execute for.
+    volatile uint32_t  budget;
+    
+    // These fields track the current activation of the server, i.e. the time
+    // it became active and the number of ticks it has consumed since.
+    uint32_t  active;
+    uint32_t  activationTime;
+    uint32_t  consumed;
+    
+    // Pending replenishments, stored as a ring in order of their due time.
+    OS_replenishment_t  replenishments[FPS_SS_MAX_REPLENISHMENTS];
+    uint32_t            replenishmentHead;
+    uint32_t            nReplenishments;
+    
+    // The job queue. This is a ring of nJobs slots, so it can hold up to 
+    // nJobs - 1 jobs.
+    OS_aperiodicJobSlot_t*  jobs;
+    size_t                  nJobs;
+    volatile uint32_t       jobHead;
+    volatile uint32_t       jobTail;
+    
+    // This field is 1 while the server is executing a job.
+    volatile uint32_t  busy;
+    
+    // The server waits in this queue whilst it has no jobs or no budget. 
+    OS_tcbPriorityQueue_t  _waitingTaskQueue;
+    OS_TCB_t*              _waitingTasks[1];
+} OS_sporadicServer_t;
 
 extern OS_Scheduler_t const fixedPriorityScheduler;
 
@@ -26,4 +128,55 @@ extern OS_Scheduler_t const fixedPriorityScheduler;
 */
 void OS_InitFPS(void);
 
+/**
+* @brief Determine whether the admitted task set would still be schedulable if 
+*   a task had the given priority and period. This must only be called in 
+*   handler mode.
+* @param tcb The task.
+* @param priority The priority to analyse the task at.
+* @param period The period to analyse the task with.
+* @return 1 if the set would be schedulable, or the task has not been admitted 
+*   with declared timing.
+* @return 0 if any admitted task could miss its deadline.
+*/
+uint32_t FPS_IsSchedulableWith(OS_TCB_t* const tcb, 
+                                 const uint32_t priority, 
+                                 const uint32_t period);
+
+/**
+* @brief Initialise a sporadic server and register it with the fixed-priority 
+*   scheduler. This must be called before OS_Start(), and the server must then
+*   be added with OS_AddTask(&server->tcb, priority). At most 
+*   FPS_MAX_SPORADIC_SERVERS servers may be registered.
+* @param server Pointer to the sporadic server to initialise.
+* @param stack Pointer to the TOP OF the server task's stack. See 
+*   OS_InitialiseTCB().
+* @param jobs Pointer to a statically declared array of job slots.
+* @param nJobs The number of elements in the jobs array.
+* @param capacity The maximum number of ticks the server may execute for in any
+*   window of period ticks.
+* @param period The replenishment period in ticks.
+*/
+void OS_InitSporadicServer(OS_sporadicServer_t* const server,
+                             uint32_t* const stack,
+                             OS_aperiodicJobSlot_t* const jobs,
+                             const size_t nJobs,
+                             const uint32_t capacity,
+                             const uint32_t period);
+
+/**
+* @brief Queue an aperiodic job to be executed by a sporadic server. This may be
+*   called from a task or from an interrupt handler. When called from a task, 
+*   the server is woken immediately; when called from an interrupt handler, it
+*   is woken on the next tick.
+* @param server Pointer to the sporadic server.
+* @param func The job function to execute.
+* @param arg The argument to pass to the job function.
+* @return 1 if the job was queued.
+* @return 0 if the server's job queue is full.
+*/
+uint32_t OS_SporadicServerSubmit(OS_sporadicServer_t* const server,
+                                   const OS_aperiodicJob_t func,
+                                   void* const arg);
+
 #endif  // FIXED_PRIORITY_SCHEDULER
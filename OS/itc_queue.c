@@ -1,111 +1,699 @@
 #include "itc_queue.h"
 
 #include <string.h>
+#include "cmsis_armcc.h"
 
 #include "os.h"
+#include "os_internal.h"
+#include "queue_set.h"
 
 #include "debugTools.h"
 
-/* This function initailises the data and dest fields to 0, and initialises
-the queues mutex and semaphore. Note, a location in the msgbuf array is 
-deemed to be empty only when the dest field is 0. */
+static void ITCTaskExit(OS_TCB_t* const task);
+
+/* Every initialised queue, so that an exiting task's mailboxes can be freed. */
+static OS_itcQueue_t* _queues = 0;
+static OS_exitHook_t _exitHook = { ITCTaskExit, 0 };
+
+/* This function initialises every message and links them into the free list,
+initialises every mailbox as unused, and initialises the queue's mutex and 
+the senders' waiting queue. The first queue initialised registers the exit hook
+that frees the mailboxes of exiting tasks. */
 void OS_InitITCQueue(OS_itcQueue_t* const queue)
 {
-    for (int i = 0; i < ITC_MAX_MSGS; i++)
+    queue->freeList = 0;
+    for (int i = ITC_MAX_MSGS - 1; i >= 0; i--)
     {
         queue->msgbuf[i].data = 0;
         queue->msgbuf[i].dest = 0;
+        queue->msgbuf[i].nBlocks = 0;
+        queue->msgbuf[i].next = queue->freeList;
+        queue->freeList = &queue->msgbuf[i];
+    }
+    
+    for (int i = 0; i < ITC_MAX_MAILBOXES; i++)
+    {
+        OS_itcMailbox_t* mailbox = &queue->mailboxes[i];
+        
+        mailbox->owner = 0;
+        for (int p = 0; p < ITC_MSG_PRIORITIES; p++)
+        {
+            mailbox->head[p] = 0;
+            mailbox->tail[p] = 0;
+        }
+        
+        mailbox->ready = 0;
+        mailbox->set = 0;
+        OS_InitTCBPriorityQueue(&mailbox->_waitingTaskQueue, mailbox->_waitingTasks, 1, TCBPQ_ORDER_BY_PRIORITY);
     }
     
+    queue->count = 0;
     OS_InitMutex(&queue->mux);
-    OS_InitSemaphore(&queue->sem, ITC_MAX_MSGS);
+    OS_InitTCBPriorityQueue(&queue->_sendersQueue, queue->_senders, MAX_TASKS, TCBPQ_ORDER_BY_PRIORITY);
+    OS_InitTCBPriorityQueue(&queue->_urgentSendersQueue, queue->_urgentSenders, MAX_TASKS, TCBPQ_ORDER_BY_PRIORITY);
+    
+    queue->shedding = 0;
+    queue->nDropped = 0;
+    queue->stats = 0;
+    
+    if (_queues == 0)
+    {
+        OS_AddExitHook(&_exitHook);
+    }
+    
+    queue->_next = _queues;
+    _queues = queue;
 }
 
-void OS_ITCSendMsg(OS_itcQueue_t* const queue, 
-                    const void* const data, 
-                    const size_t dataSz,
-                    OS_TCB_t* const dest)
+/* This function finds the mailbox of a task. If the task does not yet have a
+mailbox and create is set, the first unused mailbox is given to it. It returns 
+0 if the task has no mailbox and none is given to it. Mailboxes are only 
+claimed and freed with the queue's mutex held. A task's own mailbox is only 
+freed once it has exited, so a task may search for its own mailbox without the
+mutex. */
+static OS_itcMailbox_t* FindMailbox(OS_itcQueue_t* const queue, 
+                                      OS_TCB_t* const tcb,
+                                      const uint32_t create)
 {
-    // Check if the queue is full here as there is no need to continue to try 
-    // and acquire the mutex if it is. In fact, if the mutex is acquired even
-    // though the msgbuf is full, then no message will be added to the queue,
-    // but a resource from the semaphore will still be acquired at the end of 
-    // the function - bad.
-    if (OS_SemaphoreFull(&queue->sem))
+    OS_itcMailbox_t* unused = 0;
+    
+    for (uint32_t i = 0; i < ITC_MAX_MAILBOXES; i++)
+    {
+        OS_itcMailbox_t* mailbox = &queue->mailboxes[i];
+        
+        if (mailbox->owner == tcb)
+        {
+            return mailbox;
+        }
+        
+        if (mailbox->owner == 0 && unused == 0)
+        {
+            unused = mailbox;
+        }
+    }
+    
+    if (create && unused)
     {
-        // There is no empty location in msgbuf, so make the calling task wait.
-        OS_SemaphoreWait(&queue->sem, OS_GetCheckCode());        
+        unused->owner = tcb;
+        return unused;
     }
     
+    return 0;
+}
+
+/* This function determines whether there is a free message that a message of
+the given priority may use. The last ITC_URGENT_RESERVE free messages are kept 
+for urgent messages. */
+static uint32_t HasFreeMsg(OS_itcQueue_t* const queue, const uint32_t priority)
+{
+    uint32_t nFree = ITC_MAX_MSGS - queue->count;
+    
+    return nFree > ((priority == ITC_PRIORITY_URGENT) ? 0 : ITC_URGENT_RESERVE);
+}
+
+/* This function waits, with the queue's mutex held, until there is a free 
+message in the queue for a message of the given priority. The mutex is held 
+again when it returns. */
+static void WaitForFreeMsg(OS_itcQueue_t* const queue, const uint32_t priority)
+{
+    while (!HasFreeMsg(queue, priority))
+    {
+        // The queue is full, so wait for a message to be read. The check code 
+        // is taken after releasing the mutex, as releasing it changes the 
+        // check code, and the queue is checked again in case a message was 
+        // read in between.
+        OS_MutexRelease(&queue->mux);
+        
+        uint32_t checkCode = OS_GetCheckCode();
+        if (!HasFreeMsg(queue, priority))
+        {
+            if (queue->stats)
+            {
+                queue->stats->senderBlocks++;
+            }
+            
+            OS_Wait((priority == ITC_PRIORITY_URGENT) ? &queue->_urgentSendersQueue : &queue->_sendersQueue, checkCode);
+        }
+        
+        OS_MutexAquire(&queue->mux);
+    }
+}
+
+/* This function takes a free message for a message of the given priority from 
+the queue, waiting for one if the queue is full. It returns with the queue's mutex held. */
+static OS_itcMsg_t* AllocMsg(OS_itcQueue_t* const queue, const uint32_t priority)
+{
     OS_MutexAquire(&queue->mux);
+    WaitForFreeMsg(queue, priority);
+    
+    OS_itcMsg_t* msg = queue->freeList;
+    queue->freeList = msg->next;
+    msg->next = 0;
+    msg->priority = priority;
+    
+    return msg;
+}
+
+/* This function appends a message to the list of its priority in a mailbox. 
+The queue's mutex must be held. */
+static void AppendMsg(OS_itcQueue_t* const queue, 
+                        OS_itcMailbox_t* const mailbox, 
+                        OS_itcMsg_t* const msg)
+{
+    uint32_t p = msg->priority;
     
-    // Find an empty place in the queue and insert the message there.
-    for (uint32_t i = 0; i < ITC_MAX_MSGS; i++) 
+    msg->dest = mailbox->owner;
+    msg->next = 0;
+    
+    if (mailbox->tail[p])
     {
-        if (queue->msgbuf[i].dest == 0) 
+        mailbox->tail[p]->next = msg;
+    }
+    else
+    {
+        mailbox->head[p] = msg;
+        mailbox->ready |= (1UL << p);
+    }
+    
+    mailbox->tail[p] = msg;
+    queue->count++;
+    
+    if (queue->stats)
+    {
+        msg->sentAt = OS_ElapsedTicks();
+        queue->stats->nSent++;
+        if (queue->count > queue->stats->highWater)
         {
-            queue->msgbuf[i].dataSz = dataSz;
-            memcpy(&queue->msgbuf[i].data, &data, dataSz);           
-            queue->msgbuf[i].dest = dest;
-            break;
+            queue->stats->highWater = queue->count;
         }
     }
+}
+
+/* This function wakes one waiting sender that can use a free message, if there
+is one. Urgent senders are woken first, as they may be able to use the reserved
+messages when no other sender can. */
+static void WakeSender(OS_itcQueue_t* const queue)
+{
+    if (queue->_urgentSendersQueue.length && HasFreeMsg(queue, ITC_PRIORITY_URGENT))
+    {
+        OS_Notify(&queue->_urgentSendersQueue);
+    }
+    else if (queue->_sendersQueue.length && HasFreeMsg(queue, ITC_PRIORITY_NORMAL))
+    {
+        OS_Notify(&queue->_sendersQueue);
+    }
+}
+
+/* This function releases the queue's mutex after messages have been appended
+to a mailbox, and wakes the mailbox's owner. */
+static void ReleaseAndWakeReceiver(OS_itcQueue_t* const queue, 
+                                     OS_itcMailbox_t* const mailbox)
+{
+    OS_MutexRelease(&queue->mux);
+    
+    // Wake the destination only if it is waiting. If it is about to wait, 
+    // releasing the mutex has changed the check code so its wait is aborted.
+    if (mailbox->_waitingTaskQueue.length)
+    {
+        OS_Notify(&mailbox->_waitingTaskQueue);
+    }
+    
+    if (mailbox->set)
+    {
+        OS_QueueSetSignal(mailbox->set);
+    }
+    
+    // A reader that freed several messages at once only woke one sender, so 
+    // pass the wakeup on to the next sender if there is still space.
+    WakeSender(queue);
+}
+
+/* This function appends a message taken with AllocMsg to the mailbox of its 
+destination, releases the queue's mutex and wakes the destination. If the 
+destination has no mailbox and none is free, the message is returned to the 
+free list instead and the function returns 0. */
+static uint32_t PostMsg(OS_itcQueue_t* const queue, 
+                          OS_itcMsg_t* const msg, 
+                          OS_TCB_t* const dest)
+{
+    OS_itcMailbox_t* mailbox = FindMailbox(queue, dest, 1);
+    
+    if (mailbox == 0)
+    {
+        msg->next = queue->freeList;
+        queue->freeList = msg;
+        queue->nDropped++;
         
-    OS_MutexRelease(&queue->mux);  
-    OS_SemaphoreAquire(&queue->sem); 
+        // The message may have been the one a waiting sender needed.
+        OS_MutexRelease(&queue->mux);
+        WakeSender(queue);
+        return 0;
+    }
+    
+    AppendMsg(queue, mailbox, msg);
+    ReleaseAndWakeReceiver(queue, mailbox);
+    return 1;
 }
 
-void OS_ITCReadMsg(OS_itcQueue_t* const queue, void** const data)
+/* This function removes the oldest message of the highest priority from a 
+mailbox, which must not be empty. The queue's mutex must be held. */
+static OS_itcMsg_t* PopMsg(OS_itcMailbox_t* const mailbox)
 {
-    // Check if the queue is empty here and if it is, make the calling task
-    // wait. If the calling task was able to acquire the semaphore, even though
-    // the msgbuf is empty, then no message would be found but a resource 
-    // would still be released back to the semaphore at the end of the function,
-    // which is bad.
-    if (OS_SemaphoreEmpty(&queue->sem))
+    uint32_t p = 31 - __CLZ(mailbox->ready);
+    OS_itcMsg_t* msg = mailbox->head[p];
+    
+    mailbox->head[p] = msg->next;
+    if (mailbox->head[p] == 0)
     {
-        OS_SemaphoreWait(&queue->sem, OS_GetCheckCode());
+        mailbox->tail[p] = 0;
+        mailbox->ready &= ~(1UL << p);
     }
     
+    return msg;
+}
+
+/* This function removes the next message from the calling task's mailbox, 
+waiting for one if the mailbox is empty. It returns with the queue's mutex 
+held. */
+static OS_itcMsg_t* TakeMsg(OS_itcQueue_t* const queue)
+{
     OS_MutexAquire(&queue->mux);
     
-    for (uint32_t i = 0; i < ITC_MAX_MSGS; i++)
+    OS_itcMailbox_t* mailbox = FindMailbox(queue, OS_CurrentTCB(), 1);
+    
+    // Every task that reads from the queue needs a mailbox, so 
+    // ITC_MAX_MAILBOXES must be at least the number of readers.
+    ASSERT(mailbox);
+    
+    while (mailbox->ready == 0)
     {
-        if (queue->msgbuf[i].dest == OS_CurrentTCB())
+        // The mailbox is empty, so wait for a message to be sent to it. See 
+        // WaitForFreeMsg for why the check code is taken after the release.
+        OS_MutexRelease(&queue->mux);
+        
+        uint32_t checkCode = OS_GetCheckCode();
+        if (mailbox->ready == 0)
         {
-            // Copy the message data from the queue to the data output 
-            // paramater, and remove the message from the message queue.
-            memcpy(data, &queue->msgbuf[i].data, queue->msgbuf[i].dataSz);
-            queue->msgbuf[i].data = 0;
-            queue->msgbuf[i].dest = 0;
-            break;
-        }            
+            if (queue->stats)
+            {
+                queue->stats->receiverBlocks++;
+            }
+            
+            OS_Wait(&mailbox->_waitingTaskQueue, checkCode);
+        }
+        
+        OS_MutexAquire(&queue->mux);
+    }
+    
+    return PopMsg(mailbox);
+}
+
+/* This function records the latency of a message that has been read. */
+static void RecordLatency(OS_itcStats_t* const stats, const OS_itcMsg_t* const msg)
+{
+    uint32_t latency = OS_ElapsedTicks() - msg->sentAt;
+    uint32_t bucket = latency ? 32 - __CLZ(latency) : 0;
+    
+    if (bucket >= ITC_LATENCY_BUCKETS)
+    {
+        bucket = ITC_LATENCY_BUCKETS - 1;
     }
     
+    stats->latencyHist[bucket]++;
+    stats->nRead++;
+    if (latency > stats->maxLatency)
+    {
+        stats->maxLatency = latency;
+    }
+}
+
+/* This function returns a message that has been read to the free list. The 
+queue's mutex must be held. */
+static void PushFreeMsg(OS_itcQueue_t* const queue, OS_itcMsg_t* const msg)
+{
+    if (queue->stats)
+    {
+        RecordLatency(queue->stats, msg);
+    }
+    
+    msg->data = 0;
+    msg->dest = 0;
+    msg->nBlocks = 0;
+    msg->next = queue->freeList;
+    queue->freeList = msg;
+    queue->count--;
+}
+
+/* This function releases the queue's mutex after messages have been freed, and
+wakes a sender waiting for a free message. */
+static void ReleaseAndWakeSender(OS_itcQueue_t* const queue)
+{
     OS_MutexRelease(&queue->mux);
-    OS_SemaphoreRelease(&queue->sem);
+    WakeSender(queue);
+}
+
+/* This function returns a message taken with TakeMsg to the free list, 
+releases the queue's mutex and wakes a sender waiting for a free message. */
+static void FreeMsg(OS_itcQueue_t* const queue, OS_itcMsg_t* const msg)
+{
+    PushFreeMsg(queue, msg);
+    ReleaseAndWakeSender(queue);
+}
+
+uint32_t OS_ITCSendMsg(OS_itcQueue_t* const queue, 
+                         const void* const data, 
+                         const size_t dataSz,
+                         OS_TCB_t* const dest)
+{
+    return OS_ITCSendMsgPriority(queue, data, dataSz, dest, ITC_PRIORITY_NORMAL);
+}
+
+uint32_t OS_ITCSendMsgPriority(OS_itcQueue_t* const queue, 
+                                 const void* const data, 
+                                 const size_t dataSz,
+                                 OS_TCB_t* const dest,
+                                 const uint32_t priority)
+{
+    ASSERT(priority < ITC_MSG_PRIORITIES);
+    
+    if (queue->shedding)
+    {
+        queue->nDropped++;
+        return 0;
+    }
+    
+    OS_itcMsg_t* msg = AllocMsg(queue, priority);
+    
+    msg->dataSz = dataSz;
+    memcpy(&msg->data, &data, dataSz);
+    msg->nBlocks = 0;
+    
+    return PostMsg(queue, msg, dest);
+}
+
+void OS_ITCReadMsg(OS_itcQueue_t* const queue, void** const data)
+{
+    OS_itcMsg_t* msg = TakeMsg(queue);
+    
+    // A message of blocks must be read with OS_ITCReadBlocks.
+    ASSERT(msg->nBlocks == 0);
+    
+    // Copy the message data from the queue to the data output paramater.
+    memcpy(data, &msg->data, msg->dataSz);
+    
+    FreeMsg(queue, msg);
+}
+
+/* This function frees the blocks of a message of blocks that was dropped. The
+blocks belong to the queue once they have been sent, so they must not be lost.
+*/
+static void FreeBlocks(void* const* const blocks, const uint32_t nBlocks)
+{
+    for (uint32_t i = 0; i < nBlocks; i++)
+    {
+        OS_ITCFreeBlock(blocks[i]);
+    }
+}
+
+uint32_t OS_ITCSendBlocks(OS_itcQueue_t* const queue, 
+                            void* const* const blocks, 
+                            const uint32_t nBlocks,
+                            OS_TCB_t* const dest)
+{
+    ASSERT(nBlocks > 0 && nBlocks <= ITC_MAX_BLOCKS);
+    
+    if (queue->shedding)
+    {
+        FreeBlocks(blocks, nBlocks);
+        queue->nDropped++;
+        return 0;
+    }
+    
+    OS_itcMsg_t* msg = AllocMsg(queue, ITC_PRIORITY_NORMAL);
+    
+    for (uint32_t i = 0; i < nBlocks; i++)
+    {
+        msg->blocks[i] = blocks[i];
+    }
+    
+    msg->nBlocks = nBlocks;
+    msg->dataSz = 0;
+    
+    if (!PostMsg(queue, msg, dest))
+    {
+        FreeBlocks(blocks, nBlocks);
+        return 0;
+    }
+    
+    return 1;
+}
+
+uint32_t OS_ITCSendBlock(OS_itcQueue_t* const queue, 
+                           void* const block, 
+                           OS_TCB_t* const dest)
+{
+    return OS_ITCSendBlocks(queue, &block, 1, dest);
+}
+
+uint32_t OS_ITCReadBlocks(OS_itcQueue_t* const queue, 
+                            void** const blocks, 
+                            const uint32_t maxBlocks)
+{
+    OS_itcMsg_t* msg = TakeMsg(queue);
+    
+    // A message of data must be read with OS_ITCReadMsg, and every block of 
+    // the message must fit in the blocks array.
+    ASSERT(msg->nBlocks > 0 && msg->nBlocks <= maxBlocks);
+    
+    uint32_t nBlocks = msg->nBlocks;
+    for (uint32_t i = 0; i < nBlocks; i++)
+    {
+        blocks[i] = msg->blocks[i];
+    }
+    
+    FreeMsg(queue, msg);
+    return nBlocks;
+}
+
+void* OS_ITCReadBlock(OS_itcQueue_t* const queue)
+{
+    void* block;
+    
+    OS_ITCReadBlocks(queue, &block, 1);
+    return block;
+}
+
+void OS_ITCFreeBlock(void* const block)
+{
+    OS_mempool_t* pool = OS_MempoolFind(block);
+    
+    ASSERT(pool);
+    OS_Dalloc(pool, block);
+}
+
+uint32_t OS_ITCSendBatch(OS_itcQueue_t* const queue, 
+                           void* const* const msgs, 
+                           const uint32_t n,
+                           OS_TCB_t* const dest)
+{
+    if (queue->shedding)
+    {
+        queue->nDropped += n;
+        return 0;
+    }
+    
+    OS_MutexAquire(&queue->mux);
+    
+    OS_itcMailbox_t* mailbox = FindMailbox(queue, dest, 1);
+    uint32_t sent = 0;
+    
+    while (mailbox && sent < n)
+    {
+        if (!HasFreeMsg(queue, ITC_PRIORITY_NORMAL))
+        {
+            // The queue is full part way through the batch. Wake the receiver
+            // so it can read what has been sent so far, then wait for space.
+            ReleaseAndWakeReceiver(queue, mailbox);
+            OS_MutexAquire(&queue->mux);
+            WaitForFreeMsg(queue, ITC_PRIORITY_NORMAL);
+            
+            // The destination may have exited, and its mailbox been freed, 
+            // whilst the mutex was released.
+            mailbox = FindMailbox(queue, dest, 0);
+            if (mailbox == 0)
+            {
+                break;
+            }
+        }
+        
+        OS_itcMsg_t* msg = queue->freeList;
+        queue->freeList = msg->next;
+        
+        msg->data = msgs[sent++];
+        msg->dataSz = sizeof(void*);
+        msg->nBlocks = 0;
+        msg->priority = ITC_PRIORITY_NORMAL;
+        AppendMsg(queue, mailbox, msg);
+    }
+    
+    queue->nDropped += n - sent;
+    
+    if (mailbox)
+    {
+        ReleaseAndWakeReceiver(queue, mailbox);
+    }
+    else
+    {
+        ReleaseAndWakeSender(queue);
+    }
+    
+    return sent;
+}
+
+uint32_t OS_ITCDrain(OS_itcQueue_t* const queue, 
+                       void** const out, 
+                       const uint32_t max)
+{
+    OS_itcMailbox_t* mailbox = FindMailbox(queue, OS_CurrentTCB(), 0);
+    
+    // Only the calling task removes messages from its mailbox, so if it is 
+    // empty now it will still be empty once the mutex is held.
+    if (mailbox == 0 || mailbox->ready == 0 || max == 0)
+    {
+        return 0;
+    }
+    
+    OS_MutexAquire(&queue->mux);
+    
+    uint32_t n = 0;
+    while (n < max && mailbox->ready)
+    {
+        OS_itcMsg_t* msg = PopMsg(mailbox);
+        
+        // A message of blocks must be read with OS_ITCReadBlocks.
+        ASSERT(msg->nBlocks == 0);
+        
+        out[n] = 0;
+        memcpy(&out[n], &msg->data, msg->dataSz);
+        n++;
+        
+        PushFreeMsg(queue, msg);
+    }
+    
+    ReleaseAndWakeSender(queue);
+    return n;
+}
+
+OS_itcMailbox_t* OS_ITCGetMailbox(OS_itcQueue_t* const queue, OS_TCB_t* const tcb)
+{
+    return FindMailbox(queue, tcb, 1);
 }
 
 uint32_t OS_ITCHasMsg(OS_itcQueue_t* const queue)
 {
-    for (uint32_t i = 0; i < ITC_MAX_MSGS; i++)
+    OS_itcMailbox_t* mailbox = FindMailbox(queue, OS_CurrentTCB(), 0);
+    
+    return (mailbox && mailbox->ready) ? 1 : 0;
+}
+
+uint32_t OS_ITCGetDepth(OS_itcQueue_t* const queue)
+{
+    return queue->count;
+}
+
+void OS_ITCEnableTelemetry(OS_itcQueue_t* const queue, OS_itcStats_t* const stats)
+{
+    OS_MutexAquire(&queue->mux);
+    
+    queue->stats = stats;
+    if (stats)
     {
-        if (queue->msgbuf[i].dest == OS_CurrentTCB())
+        memset(stats, 0, sizeof(OS_itcStats_t));
+        
+        // Messages already in the queue were not timestamped, so treat them as
+        // sent now.
+        for (uint32_t i = 0; i < ITC_MAX_MSGS; i++)
         {
-            return 1;
+            queue->msgbuf[i].sentAt = OS_ElapsedTicks();
         }
     }
-   
-    return 0;
+    
+    OS_MutexRelease(&queue->mux);
+}
+
+const OS_itcStats_t* OS_ITCGetTelemetry(OS_itcQueue_t* const queue)
+{
+    return queue->stats;
+}
+
+void OS_ITCResetTelemetry(OS_itcQueue_t* const queue)
+{
+    OS_MutexAquire(&queue->mux);
+    
+    if (queue->stats)
+    {
+        memset(queue->stats, 0, sizeof(OS_itcStats_t));
+    }
+    
+    OS_MutexRelease(&queue->mux);
+}
+
+/* This exit hook frees the mailboxes of a task that is exiting, returning any
+messages still in them to the free list. No task can be waiting in the 
+mailboxes, as only their owner waits in them. */
+static void ITCTaskExit(OS_TCB_t* const task)
+{
+    for (OS_itcQueue_t* queue = _queues; queue; queue = queue->_next)
+    {
+        OS_MutexAquire(&queue->mux);
+        
+        OS_itcMailbox_t* mailbox = FindMailbox(queue, task, 0);
+        if (mailbox == 0)
+        {
+            OS_MutexRelease(&queue->mux);
+            continue;
+        }
+        
+        while (mailbox->ready)
+        {
+            OS_itcMsg_t* msg = PopMsg(mailbox);
+            
+            // The message is not counted as read in the queue's telemetry.
+            FreeBlocks(msg->blocks, msg->nBlocks);
+            msg->data = 0;
+            msg->dest = 0;
+            msg->nBlocks = 0;
+            msg->next = queue->freeList;
+            queue->freeList = msg;
+            queue->count--;
+        }
+        
+        mailbox->set = 0;
+        mailbox->owner = 0;
+        
+        ReleaseAndWakeSender(queue);
+    }
 }
 
 void OS_ITCPrintQueue(OS_itcQueue_t* const queue)
 {
-    for (int i =0; i < ITC_MAX_MSGS; i++)
+    for (int i = 0; i < ITC_MAX_MAILBOXES; i++)
     {
-        LOG(LOG_LVL_MSG, "Queue[%d]: data = %d, dest = %x\n", i, (int)queue->msgbuf[i].data, (uint32_t)queue->msgbuf[i].dest);
+        if (queue->mailboxes[i].owner == 0)
+        {
+            continue;
+        }
+        
+        LOG(LOG_LVL_MSG, "Mailbox[%d]: owner = %x\n", i, (uint32_t)queue->mailboxes[i].owner);
+        
+        for (int p = ITC_MSG_PRIORITIES - 1; p >= 0; p--)
+        {
+            for (OS_itcMsg_t* msg = queue->mailboxes[i].head[p]; msg; msg = msg->next)
+            {
+                LOG(LOG_LVL_MSG, "    priority = %d, data = %d, blocks = %d\n", p, (int)msg->data, msg->nBlocks);
+            }
+        }
     }
     
     LOG_OUTPUT_RAW("\n");
 }
-
@@ -2,12 +2,33 @@
 #define ITC_QUEUE_H
 
 #define ITC_MAX_MSGS 10
+#define ITC_MAX_BLOCKS 4
+
+/* Message priorities. Messages of a higher priority are read before any 
+message of a lower priority in the same mailbox. ITC_URGENT_RESERVE messages of
+each queue are kept for urgent messages only, so an urgent message can be sent 
+even when the queue is full of lower priority messages. */
+#define ITC_MSG_PRIORITIES    4
+#define ITC_PRIORITY_NORMAL   0
+#define ITC_PRIORITY_URGENT   (ITC_MSG_PRIORITIES - 1)
+#define ITC_URGENT_RESERVE    1
+
+#define ITC_LATENCY_BUCKETS   16
 
 #include <stdint.h>
 
 #include "task.h"
 #include "mutex.h"
-#include "semaphore.h"
+#include "memory.h"
+#include "tcb_priority_queue.h"
+
+/* The number of destinations a queue can hold mailboxes for at once. By default
+every task can have a mailbox in every queue. It may be defined smaller in the 
+project settings to save memory, in which case a message to a new destination 
+fails whilst every mailbox is in use. A mailbox is freed when its owner exits.*/
+#ifndef ITC_MAX_MAILBOXES
+#define ITC_MAX_MAILBOXES MAX_TASKS
+#endif
 
 /**
 * @brief This structure contains one message that can be sent between tasks.
@@ -25,24 +46,125 @@ typedef struct s_itcMsg
     
     // Pointer to the receiving tcb, i.e. the destination.
     OS_TCB_t* dest;
+    
+    // The priority of the message, from ITC_PRIORITY_NORMAL to 
+    // ITC_PRIORITY_URGENT.
+    uint32_t priority;
+    
+    // The tick at which the message was sent, if the queue has telemetry.
+    uint32_t sentAt;
+    
+    // The memory pool blocks carried by the message, if it was sent with 
+    // OS_ITCSendBlocks. The receiver owns them once it has read the message.
+    void*     blocks[ITC_MAX_BLOCKS];
+    uint32_t  nBlocks;
+    
+    // The next message in the same mailbox, or in the free list.
+    struct s_itcMsg* next;
 } OS_itcMsg_t;
 
+/**
+* @brief This structure contains the mailbox of a single destination task in a
+*   message queue. Messages for the task are held in a FIFO list for each 
+*   priority, so messages of the same priority are read in the order they were
+*   sent. A bitmap of the non-empty lists lets the highest priority message be 
+*   found in O(1). Mailboxes are created by the queue the first time a task is 
+*   sent a message or reads from the queue, and freed when the task exits, 
+*   along with any messages still in them.
+*/
+typedef struct s_itcMailbox
+{
+    // The task the mailbox belongs to, or 0 if the mailbox is unused.
+    OS_TCB_t*     owner;
+    
+    // The oldest and newest messages of each priority in the mailbox.
+    OS_itcMsg_t*  head[ITC_MSG_PRIORITIES];
+    OS_itcMsg_t*  tail[ITC_MSG_PRIORITIES];
+    
+    // Bit n is set whilst there are messages of priority n, so the mailbox 
+    // holds a message whenever ready is not 0.
+    volatile uint32_t  ready;
+    
+    // Only the owner ever reads from the mailbox, so at most one task waits in
+    // its waiting queue.
+    OS_tcbPriorityQueue_t  _waitingTaskQueue;
+    OS_TCB_t*              _waitingTasks[1];
+    
+    // The queue set the mailbox is a member of, if any. See queue_set.h.
+    struct s_QueueSet*     set;
+} OS_itcMailbox_t;
+
+/**
+* @brief This structure contains the telemetry of a message queue. It is 
+*   statically allocated by the application and attached to a queue with 
+*   OS_ITCEnableTelemetry(), and is updated by the queue as it is used.
+*/
+typedef struct s_itcStats
+{
+    // Latency is the number of ticks between a message being sent and read.
+    // latencyHist[0] counts latencies of 0 ticks, and latencyHist[i] counts 
+    // latencies from 2^(i-1) to 2^i - 1 ticks. The last bucket also counts 
+    // every longer latency.
+    uint32_t  latencyHist[ITC_LATENCY_BUCKETS];
+    uint32_t  maxLatency;
+    
+    uint32_t  nSent;
+    uint32_t  nRead;
+    
+    // The largest number of messages the queue has held at once.
+    uint32_t  highWater;
+    
+    // The number of times a sender waited because the queue was full, and a
+    // receiver waited because its mailbox was empty.
+    uint32_t  senderBlocks;
+    uint32_t  receiverBlocks;
+} OS_itcStats_t;
+
 /**
 * @brief This structure contains a single Inter-Task Communication (ITC) message
-*   queue. When messages are sent to the queue, they are stored in the first 
-*   available location in msgbuf. Therefore, the order in which messages are 
-*   read cannot be guarenteed.
+*   queue. The messages in msgbuf are shared between all destinations: a free 
+*   message is taken from the free list when a message is sent, and appended to
+*   the mailbox of its destination, so both sending and reading are O(1) once 
+*   the mailbox has been found. Messages for one task are read highest priority
+*   first, and in the order they were sent within a priority. Only the task a 
+*   message is sent to is woken by it.
 */
 typedef struct s_itcQueue
 {
-    // This is the actual message queue. It stores the messages.
-    OS_itcMsg_t  msgbuf[ITC_MAX_MSGS];
+    // This is the storage for the messages.
+    OS_itcMsg_t      msgbuf[ITC_MAX_MSGS];
+    
+    // The messages in msgbuf that are not in any mailbox.
+    OS_itcMsg_t*     freeList;
+    
+    // The mailboxes of the destinations the queue has seen.
+    OS_itcMailbox_t  mailboxes[ITC_MAX_MAILBOXES];
+    
+    // The number of messages currently in the queue, for all destinations.
+    volatile uint32_t  count;
     
     // Mutex lock to prevent simultaneous access which may corrupt the queue.
-    OS_mutex_t   mux;
+    OS_mutex_t       mux;
+    
+    // Tasks waiting for a free message, because the queue was full. Senders 
+    // of urgent messages wait separately, so that they are woken first.
+    OS_tcbPriorityQueue_t  _sendersQueue;
+    OS_TCB_t*              _senders[MAX_TASKS];
+    OS_tcbPriorityQueue_t  _urgentSendersQueue;
+    OS_TCB_t*              _urgentSenders[MAX_TASKS];
+    
+    // Whilst this field is 1, messages sent to the queue are dropped instead 
+    // of being added, and counted in nDropped. It is set by a load shedding 
+    // policy when the system is overloaded. See overload.h.
+    volatile uint32_t  shedding;
+    volatile uint32_t  nDropped;
     
-    // Counting semaphore to keep track of how many messages are in the queue.
-    OS_sem_t     sem;
+    // The queue's telemetry, or 0 if it has none. See OS_ITCEnableTelemetry().
+    OS_itcStats_t*     stats;
+    
+    // The next initialised queue, so that the mailboxes of a task can be freed
+    // from every queue when it exits.
+    struct s_itcQueue* _next;
 } OS_itcQueue_t;
 
 /**
@@ -56,7 +178,11 @@ void OS_InitITCQueue(OS_itcQueue_t* const queue);
 * @brief This function sends a message to a message queue. If the message queue
 *   is full at the time of sending, then the calling task will be made to wait
 *   until a different message leaves the qeueue. At which point, the calling 
-*   task will be woken and can attempt to send the message again.
+*   task will be woken and can attempt to send the message again. If the 
+*   destination is waiting for a message, only it is woken. If the queue is 
+*   shedding load, the message is dropped and the function returns 
+*   immediately. The message is also dropped if the destination has no 
+*   mailbox in the queue and every mailbox is in use.
 * @param queue Pointer to the message queue to send a message to.
 * @param data The item of data the sending task wishes the receiving task to 
 *   recieve. Note, the data is copied into an OS_itcMsg_t structure so this 
@@ -64,27 +190,160 @@ void OS_InitITCQueue(OS_itcQueue_t* const queue);
 * @param dataSz The size in bytes of the data.
 * @param dest Pointer to the destination tcb, i.e. the task the message is 
 *   intended for.
+* @return 1 if the message was sent.
+* @return 0 if it was dropped.
+*/
+uint32_t OS_ITCSendMsg(OS_itcQueue_t* const queue, 
+                         const void* const data,
+                         const size_t dataSz,
+                         OS_TCB_t* const dest);
+
+/**
+* @brief This function sends a message with a priority to a message queue. It is
+*   otherwise the same as OS_ITCSendMsg(), which sends messages with 
+*   ITC_PRIORITY_NORMAL. The message is read before any message of a lower 
+*   priority already in the destination's mailbox. Only messages of 
+*   ITC_PRIORITY_URGENT may use the last ITC_URGENT_RESERVE free messages.
+* @param queue Pointer to the message queue to send a message to.
+* @param data The item of data to send. See OS_ITCSendMsg().
+* @param dataSz The size in bytes of the data.
+* @param dest Pointer to the destination tcb.
+* @param priority The priority of the message, from ITC_PRIORITY_NORMAL to 
+*   ITC_PRIORITY_URGENT.
+* @return 1 if the message was sent.
+* @return 0 if it was dropped.
 */
-void OS_ITCSendMsg(OS_itcQueue_t* const queue, 
-                     const void* const data,
-                     const size_t dataSz,
-                     OS_TCB_t* const dest);
+uint32_t OS_ITCSendMsgPriority(OS_itcQueue_t* const queue, 
+                                 const void* const data,
+                                 const size_t dataSz,
+                                 OS_TCB_t* const dest,
+                                 const uint32_t priority);
       
 /**
 * @brief This function allows the calling task to read a message from a 
-*   message queue. It will find the first message in the queue meant for the 
-*   calling task, and copy the message's data field into the data parameter. 
+*   message queue. It will take the oldest message in the calling task's 
+*   mailbox, and copy the message's data field into the data parameter. 
 *   To check for multiple messages for one task, OS_ITCHasMsg should be used
-*   in conjuction with a while loop. If the message queue is full at the time of
-*   reading, then the calling tasks will be made to wait until a message enters 
-*   the queue. At which point the calling task will be woken and read from the 
-*   queue again.   
+*   in conjuction with a while loop. If there is no message for the calling 
+*   task at the time of reading, then the calling task will be made to wait 
+*   until one is sent to it. At which point the calling task will be woken and 
+*   read from the queue again.
 * @param queue Pointer to the message queue to read a message from.                 
 * @param data Pointer to a variable which the data from the message will be 
 *   copied to.                     
 */                     
 void OS_ITCReadMsg(OS_itcQueue_t* const queue, void** data);      
 
+/**
+* @brief This function sends memory pool blocks to a message queue as a single 
+*   message without copying them. Ownership of the blocks passes to the 
+*   receiver, which must free each of them with OS_ITCFreeBlock() once it is 
+*   finished with them, and the sender must not use them after sending. It 
+*   waits if the queue is full, as OS_ITCSendMsg() does. If the message is 
+*   dropped, because the queue is shedding load or the destination has no 
+*   mailbox, the blocks are freed.
+* @param queue Pointer to the message queue to send the blocks to.
+* @param blocks Array of pointers to blocks allocated with OS_Malloc(), from 
+*   any pool registered with OS_MempoolRegister().
+* @param nBlocks The number of blocks, from 1 to ITC_MAX_BLOCKS.
+* @param dest Pointer to the destination tcb.
+* @return 1 if the message was sent.
+* @return 0 if it was dropped.
+*/
+uint32_t OS_ITCSendBlocks(OS_itcQueue_t* const queue, 
+                            void* const* const blocks, 
+                            const uint32_t nBlocks,
+                            OS_TCB_t* const dest);
+
+/**
+* @brief This function sends a single memory pool block to a message queue 
+*   without copying it. See OS_ITCSendBlocks().
+* @param queue Pointer to the message queue to send the block to.
+* @param block Pointer to a block allocated with OS_Malloc(), from a pool 
+*   registered with OS_MempoolRegister().
+* @param dest Pointer to the destination tcb.
+* @return 1 if the message was sent.
+* @return 0 if it was dropped.
+*/
+uint32_t OS_ITCSendBlock(OS_itcQueue_t* const queue, 
+                           void* const block, 
+                           OS_TCB_t* const dest);
+
+/**
+* @brief This function reads the next message from the calling task's mailbox,
+*   which must have been sent with OS_ITCSendBlocks(), waiting for one if there
+*   is none. The calling task then owns the blocks.
+* @param queue Pointer to the message queue to read from.
+* @param blocks Array the block pointers will be written to.
+* @param maxBlocks The length of the blocks array. It must be at least the 
+*   number of blocks in the message.
+* @return The number of blocks in the message.
+*/
+uint32_t OS_ITCReadBlocks(OS_itcQueue_t* const queue, 
+                            void** const blocks, 
+                            const uint32_t maxBlocks);
+
+/**
+* @brief This function reads the next message from the calling task's mailbox,
+*   which must have been sent with OS_ITCSendBlock(). See OS_ITCReadBlocks().
+* @param queue Pointer to the message queue to read from.
+* @return Pointer to the block, which the calling task now owns.
+*/
+void* OS_ITCReadBlock(OS_itcQueue_t* const queue);
+
+/**
+* @brief This function frees a block received through a message queue back to
+*   the memory pool it was allocated from, which must have been registered 
+*   with OS_MempoolRegister().
+* @param block Pointer to the block.
+*/
+void OS_ITCFreeBlock(void* const block);
+
+/**
+* @brief This function sends several pointer-sized messages to the same 
+*   destination, holding the queue's mutex once for the whole batch and waking 
+*   the destination at most once. If the queue fills part way through, the 
+*   destination is woken to read what has been sent so far and the calling 
+*   task waits for space before sending the rest. If the queue is shedding 
+*   load, the whole batch is dropped. If the destination has no mailbox and 
+*   none is free, or the destination exits part way through the batch, the 
+*   rest of the batch is dropped.
+* @param queue Pointer to the message queue to send the messages to.
+* @param msgs Array of the data of each message, in the order to send them.
+* @param n The number of messages in msgs.
+* @param dest Pointer to the destination tcb.
+* @return The number of messages sent, which is n unless some were dropped.
+*/
+uint32_t OS_ITCSendBatch(OS_itcQueue_t* const queue, 
+                           void* const* const msgs, 
+                           const uint32_t n,
+                           OS_TCB_t* const dest);
+
+/**
+* @brief This function reads every message in the calling task's mailbox, up to
+*   max, holding the queue's mutex once and waking at most one waiting sender.
+*   It does not wait, so if there are no messages it returns 0 straight away.
+* @param queue Pointer to the message queue to read from.
+* @param out Array the data of each message is copied to, oldest first.
+* @param max The length of the out array.
+* @return The number of messages read.
+*/
+uint32_t OS_ITCDrain(OS_itcQueue_t* const queue, 
+                       void** const out, 
+                       const uint32_t max);
+
+/**
+* @brief This function returns the mailbox of a task in a message queue, 
+*   creating it if the task does not yet have one. The mailbox is not locked, 
+*   so this should be called before the queue is in use, e.g. to add it to a 
+*   queue set.
+* @param queue Pointer to the message queue.
+* @param tcb Pointer to the task.
+* @return Pointer to the task's mailbox.
+* @return 0 if the task has no mailbox and every mailbox is in use.
+*/
+OS_itcMailbox_t* OS_ITCGetMailbox(OS_itcQueue_t* const queue, OS_TCB_t* const tcb);
+
 /**
 * @brief This function determines whether there is a message in a message queue
 *   for the calling task.
@@ -94,6 +353,39 @@ void OS_ITCReadMsg(OS_itcQueue_t* const queue, void** data);
 */                     
 uint32_t OS_ITCHasMsg(OS_itcQueue_t* const queue);  
 
+/**
+* @brief This function returns the number of messages currently in a message 
+*   queue, for all destinations. It may be called from handler mode.
+* @param queue Pointer to the queue in question.
+*/
+uint32_t OS_ITCGetDepth(OS_itcQueue_t* const queue);
+
+/**
+* @brief This function attaches telemetry to a message queue and resets it. 
+*   From then on the queue records the latency of every message, its high-water
+*   depth and how often senders and receivers wait. Queues have no telemetry 
+*   unless this is called, and then pay only the cost of checking for it.
+* @param queue Pointer to the message queue.
+* @param stats Pointer to a statically allocated telemetry structure, or 0 to
+*   remove the queue's telemetry.
+*/
+void OS_ITCEnableTelemetry(OS_itcQueue_t* const queue, OS_itcStats_t* const stats);
+
+/**
+* @brief This function returns the telemetry of a message queue. The fields may
+*   be read at any time, but are only consistent with each other whilst the 
+*   queue is not in use.
+* @param queue Pointer to the message queue.
+* @return Pointer to the queue's telemetry, or 0 if it has none.
+*/
+const OS_itcStats_t* OS_ITCGetTelemetry(OS_itcQueue_t* const queue);
+
+/**
+* @brief This function resets every field of a message queue's telemetry to 0.
+* @param queue Pointer to the message queue.
+*/
+void OS_ITCResetTelemetry(OS_itcQueue_t* const queue);
+
 /**
 * @brief Print the contents of the queue.
 * @param queue Pointer to the queue to print.
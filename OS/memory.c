@@ -1,17 +1,28 @@
 #include "memory.h"
 
+#include "cmsis_armcc.h"
+
 #include "os.h"
+#include "os_internal.h"
 #include "mutex.h"
 #include "semaphore.h"
 
+/* The pools registered with OS_MempoolRegister(), so the pool a block belongs 
+to can be found. */
+static OS_mempool_t* _pools[OS_MAX_MEMPOOLS];
+static uint32_t _nPools = 0;
+
 void OS_InitMempool(OS_mempool_t* const pool,
                       const size_t blockSz,
                       const size_t nBlocks,
                       void** elements)
 {   
     pool->head = 0;
+    pool->lockFree = 0;
     pool->blockSz = blockSz;
     pool->nBlocks = nBlocks;
+    pool->start = (char* )&elements[0];
+    pool->end = pool->start + (blockSz * nBlocks);
     
     // Loop through the elements array and add the address of each element
     // to the memory pool.
@@ -25,8 +36,143 @@ void OS_InitMempool(OS_mempool_t* const pool,
     OS_InitSemaphore(&pool->sem, nBlocks);
 }
 
+/*
+In a lock-free pool, each free block holds the index plus one of the next free 
+block in its first word, and the pool's freeHead holds the index plus one of the
+first free block, tagged with a count in its upper bits. The count is changed by
+every pop and push, so a head that has been popped and pushed back between a 
+task loading it and storing its replacement no longer matches, and the store 
+fails. The exclusive monitor alone would catch that on this core, as it is 
+cleared on every exception, but the tag keeps the list safe whatever clears it.
+*/
+
+#define LF_INDEX_MASK   0xFFFF
+#define LF_TAG_ONE      0x10000
+
+void OS_InitMempoolLockFree(OS_mempool_t* const pool,
+                              const size_t blockSz,
+                              const size_t nBlocks,
+                              void** elements)
+{
+    ASSERT(nBlocks <= OS_LOCK_FREE_MAX_BLOCKS && blockSz >= 4 && (blockSz & 3) == 0);
+    
+    pool->head = 0;
+    pool->lockFree = 1;
+    pool->blockSz = blockSz;
+    pool->nBlocks = nBlocks;
+    pool->start = (char* )&elements[0];
+    pool->end = pool->start + (blockSz * nBlocks);
+    pool->nWaiting = 0;
+    
+    // Link the blocks in order, so the first block is allocated first.
+    for (uint32_t i = 0; i < nBlocks; i++)
+    {
+        *(uint32_t* )(pool->start + (blockSz * i)) = (i + 1 < nBlocks) ? i + 2 : 0;
+    }
+    
+    pool->freeHead = nBlocks ? 1 : 0;
+    
+    // The semaphore is only used for its waiting tasks queue.
+    OS_InitMutex(&pool->mux);
+    OS_InitSemaphore(&pool->sem, nBlocks);
+}
+
+void OS_MempoolRegister(OS_mempool_t* const pool)
+{
+    ASSERT(_nPools < OS_MAX_MEMPOOLS);
+    _pools[_nPools++] = pool;
+}
+
+void* OS_TryMalloc(OS_mempool_t* const pool)
+{
+    uint32_t head;
+    char* block;
+    
+    ASSERT(pool->lockFree);
+    
+    do
+    {
+        head = __LDREXW((uint32_t* )&pool->freeHead);
+        if ((head & LF_INDEX_MASK) == 0)
+        {
+            __CLREX();
+            return 0;
+        }
+        
+        block = pool->start + (((head & LF_INDEX_MASK) - 1) * pool->blockSz);
+    } while (__STREXW(((head + LF_TAG_ONE) & ~LF_INDEX_MASK) | *(uint32_t* )block, 
+                      (uint32_t* )&pool->freeHead));
+    
+    return block;
+}
+
+/* This function pushes a block back onto the free list of a lock-free pool, 
+and wakes a task waiting for a block if there is one. */
+static void LockFreeFree(OS_mempool_t* const pool, void* const item)
+{
+    uint32_t index = (((char* )item - pool->start) / pool->blockSz) + 1;
+    uint32_t head;
+    
+    do
+    {
+        head = __LDREXW((uint32_t* )&pool->freeHead);
+        *(uint32_t* )item = head & LF_INDEX_MASK;
+    } while (__STREXW(((head + LF_TAG_ONE) & ~LF_INDEX_MASK) | index, 
+                      (uint32_t* )&pool->freeHead));
+    
+    // A task that is about to wait has its wait aborted by the change to the
+    // check code made by the notify.
+    __DMB();
+    if (pool->nWaiting)
+    {
+        if (__get_IPSR())
+        {
+            OS_NotifyFromISR(&pool->sem._waitingTasksQueue);
+        }
+        else
+        {
+            OS_SemaphoreNotify(&pool->sem);
+        }
+    }
+}
+
+/* This function allocates a block from a lock-free pool, waiting for one to be 
+freed if the pool is empty. */
+static void* LockFreeMalloc(OS_mempool_t* const pool)
+{
+    void* block = OS_TryMalloc(pool);
+    
+    while (!block)
+    {
+        uint32_t checkCode = OS_GetCheckCode();
+        
+        _OS_AtomicAdd(&pool->nWaiting, 1);
+        
+        __DMB();
+        block = OS_TryMalloc(pool);
+        if (!block)
+        {
+            OS_SemaphoreWait(&pool->sem, checkCode);
+        }
+        
+        _OS_AtomicAdd(&pool->nWaiting, (uint32_t)-1);
+        
+        if (!block)
+        {
+            block = OS_TryMalloc(pool);
+        }
+    }
+    
+    return block;
+}
+
 void* OS_Malloc(OS_mempool_t* const pool)
 {
+    if (pool->lockFree)
+    {
+        return LockFreeMalloc(pool);
+    }
+    
     // If all available blocks of memory have been allocated there is no point 
     // in attempting to acquire the mutex and allocate memory. Therefore, just 
     // put the calling task into the wait state if the pool is empty.
@@ -51,6 +197,12 @@ void* OS_Malloc(OS_mempool_t* const pool)
 
 void OS_Dalloc(OS_mempool_t* const pool, void* const item) 
 { 
+    if (pool->lockFree)
+    {
+        LockFreeFree(pool, item);
+        return;
+    }
+    
     OS_MutexAquire(&pool->mux);
     
     OS_block_t* block = item;
@@ -62,3 +214,21 @@ void OS_Dalloc(OS_mempool_t* const pool, void* const item)
     OS_MutexRelease(&pool->mux);
     OS_SemaphoreRelease(&pool->sem);
 }
+
+uint32_t OS_MempoolOwns(OS_mempool_t* const pool, const void* const ptr)
+{
+    return ((const char* )ptr >= pool->start && (const char* )ptr < pool->end) ? 1 : 0;
+}
+
+OS_mempool_t* OS_MempoolFind(const void* const ptr)
+{
+    for (uint32_t i = 0; i < _nPools; i++)
+    {
+        if (OS_MempoolOwns(_pools[i], ptr))
+        {
+            return _pools[i];
+        }
+    }
+    
+    return 0;
+}
@@ -6,6 +6,12 @@
 #include "mutex.h"
 #include "semaphore.h"
 
+#define OS_MAX_MEMPOOLS 8
+
+/* The largest number of blocks a lock-free pool may have, as the free list head
+holds a block index in 16 bits. */
+#define OS_LOCK_FREE_MAX_BLOCKS 0xFFFF
+
 /**
 * @brief This struct contains a single block of memory in the memory pool. These
 *   are the blocks that make up the memory pool linked list.
@@ -44,6 +50,20 @@ typedef struct s_Mempool
     // Counting semaphore to keep track of the number of allocations and 
     // deallocations to ensure the pool doesn't get emptied beyond its limits.
     OS_sem_t sem;
+    
+    // The start and end (one past the last byte) of the elements array, used
+    // to find the pool a block belongs to.
+    char* start;
+    char* end;
+    
+    // 1 if the pool was initialised with OS_InitMempoolLockFree(). The free 
+    // list of a lock-free pool is not kept in head but in freeHead, which 
+    // holds a tag in the upper 16 bits and the index of the first free block 
+    // plus one, or 0 if there is none, in the lower 16 bits. nWaiting counts 
+    // the tasks waiting in OS_Malloc() for a block.
+    uint32_t           lockFree;
+    volatile uint32_t  freeHead;
+    volatile uint32_t  nWaiting;
 } OS_mempool_t;
 
 /**
@@ -61,9 +81,37 @@ void OS_InitMempool(OS_mempool_t* const pool,
                       const size_t nBlocks,
                       void** elements);
                  
+/**
+* @brief This function initialises a lock-free memory pool. The pool's free list
+*   is a LIFO stack updated with LDREX/STREX, so allocating and freeing make no
+*   SVC calls unless a task has to wait for a block, or must be woken. Blocks 
+*   may be allocated with OS_TryMalloc() and freed from interrupt handlers. 
+*   The pool is otherwise used in the same way as one initialised with 
+*   OS_InitMempool().
+* @param pool The memory pool to initialise.
+* @param blockSz The size, in bytes, of each block, which must be a multiple of
+*   4 and at least 4.
+* @param nBlocks The number of blocks, at most OS_LOCK_FREE_MAX_BLOCKS.
+* @param elements Pointer to a statically declared array of nBlocks blocks.
+*/
+void OS_InitMempoolLockFree(OS_mempool_t* const pool,
+                              const size_t blockSz,
+                              const size_t nBlocks,
+                              void** elements);
+
+/**
+* @brief This function allocates a block from a lock-free memory pool if one is 
+*   free, without waiting. It may be called from an interrupt handler.
+* @param pool Pointer to a pool initialised with OS_InitMempoolLockFree().
+* @return Pointer to the allocated block.
+* @return 0 if the pool is empty.
+*/
+void* OS_TryMalloc(OS_mempool_t* const pool);
+
 /**
 * @brief This function allocates a block of memory in the memory pool and 
-*   returns a pointer to it.
+*   returns a pointer to it. If the pool is empty, the calling task waits until
+*   a block is freed.
 * @param pool Pointer to the pool to allocate memory from.                      
 * @return Pointer to the allocated memory location.
 */                      
@@ -72,12 +120,40 @@ void* OS_Malloc(OS_mempool_t* const pool);
                
 /**
 * @brief Care must be taken not to call this function to many times as 
-*   undefined behaviour will occur.                  
+*   undefined behaviour will occur. Blocks of a lock-free pool may be freed 
+*   from an interrupt handler.
 * @param pool Pointer to pool to deallocate memory from.
 * @param item The data to put into the deallocated block.                      
 */                      
 void OS_Dalloc(OS_mempool_t* const pool, void* const item); 
 
+/**
+* @brief This function determines whether a pointer is to memory belonging to a
+*   memory pool.
+* @param pool Pointer to the pool.
+* @param ptr The pointer to check.
+* @return 1 if the pointer is within the pool's elements array.
+* @return 0 if it is not.
+*/
+uint32_t OS_MempoolOwns(OS_mempool_t* const pool, const void* const ptr);
+
+/**
+* @brief This function registers an initialised memory pool, so that the pool
+*   its blocks belong to can be found with OS_MempoolFind(). This must be 
+*   called before OS_Start(). At most OS_MAX_MEMPOOLS pools may be registered.
+* @param pool Pointer to the pool to register.
+*/
+void OS_MempoolRegister(OS_mempool_t* const pool);
+
+/**
+* @brief This function finds the memory pool a block belongs to, by searching
+*   the pools registered with OS_MempoolRegister().
+* @param ptr Pointer to the block.
+* @return Pointer to the pool the block belongs to.
+* @return 0 if the block does not belong to any pool.
+*/
+OS_mempool_t* OS_MempoolFind(const void* const ptr);
+
 #define OS_MempoolAdd OS_Dalloc                  
 
 #endif  // MEMORY_H
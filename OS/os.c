@@ -20,14 +20,44 @@ OS_TCB_t const * const OS_idleTCB_p = &OS_idleTCB;
 /* Total elapsed ticks. */
 static volatile uint32_t _ticks = 0;
 
+/* The installed scheduling classes, highest first. _scheduler is always the 
+first class, installed by OS_Init(). When the scheduler is invoked, each class
+is asked in turn for a task to run, and the first that does not return the idle
+task wins. Every other callback is passed to the class the task belongs to. */
+static OS_Scheduler_t const * _classes[OS_MAX_SCHEDULING_CLASSES];
+static uint32_t _nClasses = 0;
 static OS_Scheduler_t const * _scheduler = 0;
 
+/* The list of tick hooks, called from the system tick handler. */
+static OS_tickHook_t* _tickHooks = 0;
+
+/* The list of exit hooks, called by each task as it exits. */
+static OS_exitHook_t* _exitHooks = 0;
+
 /* A check code which can be obtained prior to starting an operation, and 
    checked to ensure that it hasn't changed after the operation has finished. If 
    the check code has changed, then the state of the system is different to when 
    the operation began. Therefore, the operation must be done again. */
 static volatile uint32_t _checkCode;
 
+/* Calls deferred from interrupt handlers to PendSV, by OS_NotifyFromISR() and
+   _OS_DeferToPendSV(). A slot is first claimed in _isrNotifyClaimed, then its
+   call is written, and only then is it published in _isrNotifyReady, so that
+   PendSV never sees a slot whose call has not yet been written. */
+typedef struct s_DeferredCall
+{
+    void (* call)(void* const arg);
+    void* arg;
+} OS_deferredCall_t;
+
+static OS_deferredCall_t _isrDeferred[OS_MAX_ISR_NOTIFIES];
+static volatile uint32_t _isrNotifyClaimed = 0;
+static volatile uint32_t _isrNotifyReady = 0;
+
+/* Deadline monitoring. _deadlineMisses counts every miss across all tasks. */
+static OS_deadlineMissHook_t _deadlineMissHook = 0;
+static volatile uint32_t _deadlineMisses = 0;
+
 /* GLOBAL: Holds pointer to current TCB.  DO NOT MODIFY, EVER. */
 OS_TCB_t * volatile _currentTCB = 0;
 
@@ -41,10 +71,32 @@ uint32_t OS_ElapsedTicks()
 	return _ticks;
 }
 
-/* IRQ handler for the system tick. Schedules PendSV asynchronously. */
+/* This function returns the scheduling class a task belongs to. */
+static OS_Scheduler_t const * ClassOf(const OS_TCB_t* const tcb)
+{
+    return _classes[tcb->schedClass];
+}
+
+/* IRQ handler for the system tick. Invokes the tick callbacks of the 
+scheduling classes that have one, and every tick hook, then schedules PendSV 
+asynchronously. PendSV must be set last, as it will preempt this handler as 
+soon as it is set. */
 void SysTick_Handler(void) 
 {
 	_ticks = _ticks + 1;
+    for (uint32_t i = 0; i < _nClasses; i++)
+    {
+        if (_classes[i]->TickCallback)
+        {
+            _classes[i]->TickCallback(_ticks);
+        }
+    }
+    
+    for (OS_tickHook_t* hook = _tickHooks; hook; hook = hook->next)
+    {
+        hook->callback(_ticks);
+    }
+    
 	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
@@ -70,16 +122,46 @@ void OS_Init(OS_Scheduler_t const * scheduler)
 	_scheduler = scheduler;
 	SCB->CCR |= SCB_CCR_STKALIGN_Msk;
 //    *((uint32_t volatile *)0xE000ED14) |= (1 << 9); // Set STKALIGN
-	ASSERT(_scheduler->SchedulerCallback);
-	ASSERT(_scheduler->AddTaskCallback);
-	ASSERT(_scheduler->TaskExitCallback);
-    ASSERT(_scheduler->WaitCallback);
-    ASSERT(_scheduler->NotifyCallback);
-    ASSERT(_scheduler->WaitCallback);
+    _nClasses = 0;
+    OS_AddSchedulingClass(scheduler);
     
     _checkCode = 0;
 }
 
+uint32_t OS_AddSchedulingClass(OS_Scheduler_t const * scheduler)
+{
+    ASSERT(_nClasses < OS_MAX_SCHEDULING_CLASSES);
+	ASSERT(scheduler->SchedulerCallback);
+	ASSERT(scheduler->AddTaskCallback);
+	ASSERT(scheduler->TaskExitCallback);
+    ASSERT(scheduler->WaitCallback);
+    ASSERT(scheduler->NotifyCallback);
+    ASSERT(scheduler->SleepCallback);
+    
+    _classes[_nClasses] = scheduler;
+    return _nClasses++;
+}
+
+void OS_AddTickHook(OS_tickHook_t* const hook)
+{
+    ASSERT(hook->callback);
+    hook->next = _tickHooks;
+    _tickHooks = hook;
+}
+
+void OS_AddExitHook(OS_exitHook_t* const hook)
+{
+    ASSERT(hook->callback);
+    hook->next = _exitHooks;
+    _exitHooks = hook;
+}
+
+void OS_SetSchedulingClass(OS_TCB_t* const tcb, const uint32_t schedClass)
+{
+    ASSERT(schedClass < _nClasses);
+    tcb->schedClass = schedClass;
+}
+
 void OS_Start()
 {
 	ASSERT(_scheduler);
@@ -93,6 +175,13 @@ void OS_InitialiseTCB(OS_TCB_t * TCB, uint32_t * const stack,
 {
 	TCB->sp = stack - (sizeof(OS_StackFrame_t) / sizeof(uint32_t));
 	TCB->priority = TCB->state = TCB->data = 0;
+    TCB->queue = 0;
+    TCB->queueIndex = 0;
+    TCB->schedClass = 0;
+    TCB->partition = 0;
+    TCB->next = TCB->prev = 0;
+    TCB->timing.wcet = TCB->timing.period = TCB->timing.deadline = 0;
+    memset(&TCB->stats, 0, sizeof(OS_taskStats_t));
 	OS_StackFrame_t *sf = (OS_StackFrame_t *)(TCB->sp);
 	memset(sf, 0, sizeof(OS_StackFrame_t));
     
@@ -116,6 +205,13 @@ void _OS_task_end(void) {
     // want to see what happens next, or debug something, set a breakpoint at 
     // the start of PendSV_Handler (see os_asm.s) and hit 'run'.
     
+    // The exit hooks run here, in the task's own context, rather than in the 
+    // SVC handler, so that they may take mutexes.
+    for (OS_exitHook_t* hook = _exitHooks; hook; hook = hook->next)
+    {
+        hook->callback(_currentTCB);
+    }
+    
 	_OS_task_exit();
 }
 
@@ -129,24 +225,141 @@ void _svc_OS_enable_systick(void) {
 }
 
 /* SVC handler to add a task. Invokes a callback to do the work. */
-void _svc_OS_AddTask(_OS_SVC_StackFrame_t const * const stack) 
+void _svc_OS_AddTask(_OS_SVC_StackFrame_t * const stack) 
 {
 	// The TCB pointer is on the stack in the r0 position, having been passed as
     // an argument to the SVC pseudo-function. SVC handlers are called with the
     // stack pointer in r0 (see os_asm.s) so the stack can be interrogated to 
-    // find the TCB pointer. 
-	_scheduler->AddTaskCallback((OS_TCB_t *)stack->r0, stack->r1);
+    // find the TCB pointer. The status is returned by writing it back into 
+    // the stacked r0, which is the return value of the SVC pseudo-function.
+    OS_TCB_t* tcb = (OS_TCB_t *)stack->r0;
+    
+	stack->r0 = ClassOf(tcb)->AddTaskCallback(tcb, stack->r1);
+    
+    // The first job of a task that has declared its timing is released as 
+    // soon as it is added.
+    if (stack->r0 == OS_ADD_TASK_OK && tcb->timing.period)
+    {
+        tcb->stats.release = _ticks;
+        tcb->stats.absDeadline = _ticks + tcb->timing.deadline;
+    }
+}
+
+/* This function checks whether the current job of a task has run past its 
+deadline without completing. It is called for the outgoing and incoming tasks
+on every context switch, so it is kept to a handful of comparisons. */
+static void CheckDeadline(OS_TCB_t* const tcb, const uint32_t now)
+{
+    if (!tcb->timing.period || tcb->stats.missed)
+    {
+        return;
+    }
+    
+    if ((int32_t)(now - tcb->stats.absDeadline) > 0)
+    {
+        tcb->stats.missed = 1;
+        tcb->stats.nMisses++;
+        tcb->stats.lateness = now - tcb->stats.absDeadline;
+        _deadlineMisses++;
+        
+        // Clear the exclusive access flag so that OS_WaitNextPeriod() cannot
+        // count the same miss again if it was interrupted.
+        __CLREX();
+        
+        if (_deadlineMissHook)
+        {
+            _deadlineMissHook(tcb, tcb->stats.lateness);
+        }
+    }
+}
+
+/* This function notifies the task at the front of a waiting tasks queue, via
+the callback of the task's class. The check code is always changed, so that any
+task which is about to wait aborts and rechecks its condition. It must only be 
+called in handler mode. */
+static void Notify(OS_tcbPriorityQueue_t* const queue)
+{
+    OS_TCB_t* tcb = OS_TCBPriorityQueuePeek(queue);
+    
+    _checkCode++;
+    __CLREX();
+    
+    // The task at the front of the queue is the one that will be notified, so
+    // it is its class that must move it back into its running tasks.
+    if (tcb)
+    {
+        ClassOf(tcb)->NotifyCallback(queue);
+    }
+}
+
+/* This function makes the calls deferred by OS_NotifyFromISR() and 
+_OS_DeferToPendSV(). It is called from PendSV, before the next task is chosen.
+*/
+static void DrainISRNotifies(void)
+{
+    uint32_t ready;
+    
+    do
+    {
+        ready = __LDREXW((uint32_t* )&_isrNotifyReady);
+    } while (__STREXW(0, (uint32_t* )&_isrNotifyReady));
+    
+    while (ready)
+    {
+        uint32_t slot = 31 - __CLZ(ready);
+        OS_deferredCall_t deferred = _isrDeferred[slot];
+        uint32_t claimed;
+        
+        ready &= ~(1UL << slot);
+        
+        // Free the slot before notifying, so it can be reused straight away.
+        do
+        {
+            claimed = __LDREXW((uint32_t* )&_isrNotifyClaimed);
+        } while (__STREXW(claimed & ~(1UL << slot), (uint32_t* )&_isrNotifyClaimed));
+        
+        deferred.call(deferred.arg);
+    }
 }
 
-/* SVC handler to invoke the scheduler (via a callback) from PendSV. */
+/* SVC handler to invoke the scheduler (via a callback) from PendSV. Any
+notifications deferred from interrupt handlers are performed first. The 
+deadlines of the outgoing and incoming tasks are checked, and the release 
+jitter of the incoming task is recorded if this is the first time its current
+job has run. */
 OS_TCB_t const * _OS_scheduler() {
-	return _scheduler->SchedulerCallback();
+    OS_TCB_t* next = (OS_TCB_t* )OS_idleTCB_p;
+    uint32_t now = _ticks;
+    
+    DrainISRNotifies();
+    
+    for (uint32_t i = 0; i < _nClasses && next == OS_idleTCB_p; i++)
+    {
+        next = (OS_TCB_t* )_classes[i]->SchedulerCallback();
+    }
+    
+    CheckDeadline(_currentTCB, now);
+    if (next != _currentTCB)
+    {
+        CheckDeadline(next, now);
+        
+        if (next->timing.period && !next->stats.started)
+        {
+            next->stats.started = 1;
+            if (now - next->stats.release > next->stats.worstJitter)
+            {
+                next->stats.worstJitter = now - next->stats.release;
+            }
+        }
+    }
+    
+	return next;
 }
 
 /* SVC handler that's called by _OS_task_end when a task finishes.  Invokes the
    task end callback and then queues PendSV to call the scheduler. */
 void _svc_OS_task_exit(void) {
-	_scheduler->TaskExitCallback(_currentTCB);
+	ClassOf(_currentTCB)->TaskExitCallback(_currentTCB);
 	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
@@ -169,15 +382,166 @@ void _svc_OS_Wait(const _OS_SVC_StackFrame_t* const stack)
         atomTcb->state |= TASK_STATE_WAIT;
     } while (__STREXW(atomTcb, (uint32_t* )&_currentTCB));
     
-    _scheduler->WaitCallback((OS_tcbPriorityQueue_t* )stack->r0, atomTcb);
+    ClassOf(atomTcb)->WaitCallback((OS_tcbPriorityQueue_t* )stack->r0, atomTcb);
 }
 
 /* SVC handler that's called by OS_Notify. */
 void _svc_OS_Notify(const _OS_SVC_StackFrame_t* const stack) 
 {
+    Notify((OS_tcbPriorityQueue_t* )stack->r0);
+}
+
+/* SVC handler that's called by OS_NotifyAll. The task at the front of the 
+queue is notified until the queue is empty. The check code is changed once. */
+void _svc_OS_NotifyAll(const _OS_SVC_StackFrame_t* const stack)
+{
+    OS_tcbPriorityQueue_t* queue = (OS_tcbPriorityQueue_t* )stack->r0;
+    OS_TCB_t* tcb;
+    
     _checkCode++;
     __CLREX();
-    _scheduler->NotifyCallback((OS_tcbPriorityQueue_t* )stack->r0);
+    
+    while ((tcb = OS_TCBPriorityQueuePeek(queue)) != 0)
+    {
+        ClassOf(tcb)->NotifyCallback(queue);
+        
+        // Every class removes the task it notifies from the queue, but stop 
+        // rather than loop forever should one ever fail to.
+        if (OS_TCBPriorityQueuePeek(queue) == tcb)
+        {
+            break;
+        }
+    }
+}
+
+void _svc_OS_Call(const _OS_SVC_StackFrame_t* const stack)
+{
+    void (* const call)(void* const arg) = (void (*)(void* const))stack->r0;
+    
+    call((void* )stack->r1);
+}
+
+uint32_t _OS_DeferToPendSV(void (* const call)(void* const arg), void* const arg)
+{
+    uint32_t claimed;
+    uint32_t slot;
+    uint32_t ready;
+    
+    // Claim the highest free slot.
+    do
+    {
+        claimed = __LDREXW((uint32_t* )&_isrNotifyClaimed);
+        if (~claimed == 0)
+        {
+            __CLREX();
+            return 0;
+        }
+        
+        slot = 31 - __CLZ(~claimed);
+    } while (__STREXW(claimed | (1UL << slot), (uint32_t* )&_isrNotifyClaimed));
+    
+    _isrDeferred[slot].call = call;
+    _isrDeferred[slot].arg = arg;
+    __DMB();
+    
+    do
+    {
+        ready = __LDREXW((uint32_t* )&_isrNotifyReady);
+    } while (__STREXW(ready | (1UL << slot), (uint32_t* )&_isrNotifyReady));
+    
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    return 1;
+}
+
+void _OS_AtomicAdd(volatile uint32_t* const word, const uint32_t n)
+{
+    uint32_t atomWord;
+    
+    do
+    {
+        atomWord = __LDREXW((uint32_t* )word);
+    } while (__STREXW(atomWord + n, (uint32_t* )word));
+}
+
+void _OS_WakeIfWaiting(volatile uint32_t* const waiting, 
+                         OS_tcbPriorityQueue_t* const queue)
+{
+    uint32_t atomWaiting;
+    
+    // The update the waiting task is waiting for must be visible before the 
+    // flag is read.
+    __DMB();
+    
+    do
+    {
+        atomWaiting = __LDREXW((uint32_t* )waiting);
+    } while (__STREXW(0, (uint32_t* )waiting));
+    
+    if (!atomWaiting)
+    {
+        return;
+    }
+    
+    if (__get_IPSR())
+    {
+        if (!OS_NotifyFromISR(queue))
+        {
+            *waiting = 1;
+        }
+    }
+    else
+    {
+        OS_Notify(queue);
+    }
+}
+
+/* This function is the deferred call made for OS_NotifyFromISR(). */
+static void NotifyDeferred(void* const queue)
+{
+    Notify((OS_tcbPriorityQueue_t* )queue);
+}
+
+uint32_t OS_NotifyFromISR(OS_tcbPriorityQueue_t* const queue)
+{
+    return _OS_DeferToPendSV(NotifyDeferred, queue);
+}
+
+/* This function changes a task's priority field and, if the task is held in a 
+priority queue, moves it to its new position in that queue. PendSV is then set 
+in case the change means a different task should now be running. It must only 
+be called in handler mode. Unlike OS_SetPriority(), the change is not checked 
+by the task's scheduling class. */
+void _OS_SetPriority(OS_TCB_t* const tcb, const uint32_t priority)
+{
+    tcb->priority = priority;
+    if (tcb->queue)
+    {
+        OS_TCBPriorityQueueUpdate(tcb->queue, tcb);
+    }
+    
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/* SVC handler that's called by OS_SetPriority. The task's scheduling class 
+may reject the change, and the status is returned in the stacked r0, as in 
+_svc_OS_AddTask(). */
+void _svc_OS_SetPriority(_OS_SVC_StackFrame_t* const stack)
+{
+    OS_TCB_t* tcb = (OS_TCB_t* )stack->r0;
+    uint32_t priority = stack->r1;
+    
+    if (ClassOf(tcb)->SetPriorityCallback)
+    {
+        uint32_t status = ClassOf(tcb)->SetPriorityCallback(tcb, priority);
+        if (status != OS_SET_PRIORITY_OK)
+        {
+            stack->r0 = status;
+            return;
+        }
+    }
+    
+    _OS_SetPriority(tcb, priority);
+    stack->r0 = OS_SET_PRIORITY_OK;
 }
 
 /* This funtion atomically loads the current tcb and the current elapsed
@@ -198,7 +562,7 @@ void OS_Sleep(const uint32_t time)
         atomTcb->data = atomTime + time;
     } while (__STREXW(atomTcb, (uint32_t* )&_currentTCB));
     
-    _scheduler->SleepCallback(atomTcb, time, atomTime);
+    ClassOf(atomTcb)->SleepCallback(atomTcb, time, atomTime);
 }
 
 uint32_t OS_GetCheckCode(void)
@@ -206,3 +570,80 @@ uint32_t OS_GetCheckCode(void)
     return _checkCode;
 }
 
+/* Calls the deadline miss hook for a miss counted by OS_WaitNextPeriod(). It is
+run in handler mode through _OS_Call(), as the hook expects. */
+static void ReportMiss(void* const tcb)
+{
+    if (_deadlineMissHook)
+    {
+        _deadlineMissHook((OS_TCB_t* )tcb, ((OS_TCB_t* )tcb)->stats.lateness);
+    }
+}
+
+void OS_WaitNextPeriod(void)
+{
+    OS_TCB_t* tcb = _currentTCB;
+    OS_taskStats_t* stats = &tcb->stats;
+    
+    if (!tcb->timing.period)
+    {
+        OS_Yield();
+        return;
+    }
+    
+    uint32_t now = OS_ElapsedTicks();
+    if (now - stats->release > stats->worstResponse)
+    {
+        stats->worstResponse = now - stats->release;
+    }
+    stats->nJobs++;
+    
+    // If the job completed late and the context switch path has not already
+    // counted it, count the miss now, and report it to the hook from handler 
+    // mode.
+    uint32_t missed;
+    do
+    {
+        missed = __LDREXW((uint32_t* )&stats->missed);
+        if (missed || (int32_t)(now - stats->absDeadline) <= 0)
+        {
+            __CLREX();
+            break;
+        }
+    } while (__STREXW(1, (uint32_t* )&stats->missed));
+    
+    if (!missed && (int32_t)(now - stats->absDeadline) > 0)
+    {
+        _OS_AtomicAdd(&stats->nMisses, 1);
+        _OS_AtomicAdd(&_deadlineMisses, 1);
+        stats->lateness = now - stats->absDeadline;
+        _OS_Call(ReportMiss, tcb);
+    }
+    
+    // Release the next job. The deadline is moved on before the missed flag is
+    // cleared so that a context switch part way through cannot see the old 
+    // deadline with the flag cleared.
+    uint32_t nextRelease = stats->release + tcb->timing.period;
+    stats->absDeadline = nextRelease + tcb->timing.deadline;
+    stats->missed = 0;
+    stats->release = nextRelease;
+    stats->started = 0;
+    
+    // OS_Sleep(t) wakes the task once more than t ticks have elapsed, so 
+    // sleeping for one less than the delay wakes it exactly at the release.
+    int32_t delay = (int32_t)(nextRelease - now);
+    if (delay > 0)
+    {
+        OS_Sleep(delay - 1);
+    }
+}
+
+void OS_SetDeadlineMissHook(const OS_deadlineMissHook_t hook)
+{
+    _deadlineMissHook = hook;
+}
+
+uint32_t OS_GetDeadlineMissCount(void)
+{
+    return _deadlineMisses;
+}
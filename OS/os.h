@@ -7,6 +7,23 @@
 #define OS_SCHEDULER_TYPE_FPS 1
 #define OS_SCHEDULER_TYPE_SRR 2
 
+#define OS_MAX_SCHEDULING_CLASSES 3
+
+/* The number of notifications, and other calls deferred to PendSV, from 
+interrupt handlers which can be pending at once. This is the width of the 
+bitmap used to track them, so must not exceed 32. */
+#define OS_MAX_ISR_NOTIFIES 32
+
+/* Status codes returned by OS_AddTask(). */
+#define OS_ADD_TASK_OK                  0
+#define OS_ADD_TASK_ERR_FULL            1
+#define OS_ADD_TASK_ERR_UNSCHEDULABLE   2
+#define OS_ADD_TASK_ERR_INVALID         3
+
+/* Status codes returned by OS_SetPriority(). */
+#define OS_SET_PRIORITY_OK                  0
+#define OS_SET_PRIORITY_ERR_UNSCHEDULABLE   1
+
 #include "task.h"
 #include "itc_queue.h"
 #include "tcb_priority_queue.h"
@@ -28,9 +45,52 @@ enum OS_SVC_e {
 	OS_SVC_SCHEDULE,
     OS_SVC_WAIT,
     OS_SVC_NOTIFY,
+    OS_SVC_SET_PRIORITY,
+    OS_SVC_NOTIFY_ALL,
+    OS_SVC_CALL,
     OS_SVC_FORCE_PRINT
 };
 
+/**
+* @brief A function that is called when a task misses its deadline. It is called 
+*   in handler mode, either from the context switch path or, for a job found 
+*   late when it completes, from OS_WaitNextPeriod() through an SVC, so it must 
+*   be short and must not make any SVC calls.
+* @param task The task that missed its deadline.
+* @param lateness The number of ticks past its deadline the task was when the 
+*   miss was detected.
+*/
+typedef void (* OS_deadlineMissHook_t)(OS_TCB_t* const task, const uint32_t lateness);
+
+/**
+* @brief A structure holding a function to be called on every system tick. It 
+*   must be statically allocated, and is registered with OS_AddTickHook(). The
+*   callback is called in handler mode, so it must be short and must not make 
+*   any SVC calls.
+*/
+typedef struct s_TickHook
+{
+    void (* callback)(const uint32_t ticks);
+    
+    // Used by the OS to link the registered hooks. Do not modify.
+    struct s_TickHook* next;
+} OS_tickHook_t;
+
+/**
+* @brief A structure holding a function to be called when a task exits, so that
+*   resources held for it can be freed. It must be statically allocated, and is
+*   registered with OS_AddExitHook(). The callback is called in thread mode by
+*   the exiting task itself, after its task function has returned, so it may 
+*   use mutexes and other blocking calls.
+*/
+typedef struct s_ExitHook
+{
+    void (* callback)(OS_TCB_t* const task);
+    
+    // Used by the OS to link the registered hooks. Do not modify.
+    struct s_ExitHook* next;
+} OS_exitHook_t;
+
 /**
 * @brief A structure to hold callbacks for a scheduler, plus a 'preemptive' 
 *   flag. 
@@ -38,12 +98,22 @@ enum OS_SVC_e {
 typedef struct {
 	uint_fast8_t preemptive;
 	OS_TCB_t const * (* SchedulerCallback)(void);
-	void (* AddTaskCallback)(OS_TCB_t* const newTask, const uint32_t priority);
+	uint32_t (* AddTaskCallback)(OS_TCB_t* const newTask, const uint32_t priority);
 	void (* TaskExitCallback)(OS_TCB_t* const task);
     void (* InitCallback)(void);
     void (* WaitCallback)(OS_tcbPriorityQueue_t* const waitingTaskQueue, OS_TCB_t* tcb);
     void (* NotifyCallback)(OS_tcbPriorityQueue_t* const waitingTaskQueue);
     void (* SleepCallback)(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time);
+    
+    // Optional. Called from the system tick handler, before PendSV is set, with
+    // the number of elapsed ticks. Set to 0 if the scheduler has no use for it.
+    void (* TickCallback)(const uint32_t ticks);
+    
+    // Optional. Called by OS_SetPriority() before a task's priority is 
+    // changed, to check that the change is allowed. Returns OS_SET_PRIORITY_OK
+    // to allow it, or an error code to reject it. Set to 0 to allow every 
+    // change.
+    uint32_t (* SetPriorityCallback)(OS_TCB_t* const tcb, const uint32_t priority);
 } OS_Scheduler_t;
 
 /***************************/
@@ -52,10 +122,46 @@ typedef struct {
 
 /**
 * @brief Initialises the OS. Must be called before OS_start(). The argument is a 
-*        pointer to an OS_Scheduler_t structure. 
+*        pointer to an OS_Scheduler_t structure, which is installed as the 
+*        first, and highest, scheduling class. 
 */
 void OS_Init(OS_Scheduler_t const * scheduler);
 
+/**
+* @brief Installs a further scheduling class below those already installed. 
+*   Must be called after OS_Init() and before OS_Start(). When choosing a task 
+*   to run, each class is asked in the order it was installed, and a lower 
+*   class only runs its tasks if every class above it has returned the idle 
+*   task. At most OS_MAX_SCHEDULING_CLASSES classes may be installed.
+* @param scheduler Pointer to the scheduler implementing the class.
+* @return The index of the class, to be passed to OS_SetSchedulingClass().
+*/
+uint32_t OS_AddSchedulingClass(OS_Scheduler_t const * scheduler);
+
+/**
+* @brief Registers a function to be called from the system tick handler, after
+*   the schedulers' tick callbacks. Must be called before OS_Start().
+* @param hook Pointer to a statically allocated hook, with its callback set.
+*/
+void OS_AddTickHook(OS_tickHook_t* const hook);
+
+/**
+* @brief Registers a function to be called whenever a task exits. Must be 
+*   called before OS_Start(), or by a task before any task can exit.
+* @param hook Pointer to a statically allocated hook, with its callback set.
+*/
+void OS_AddExitHook(OS_exitHook_t* const hook);
+
+/**
+* @brief Sets the scheduling class a task belongs to. Must be called after 
+*   OS_InitialiseTCB() and before the task is added with OS_AddTask(). Tasks 
+*   belong to class 0, the class installed by OS_Init(), by default.
+* @param tcb The task in question.
+* @param schedClass The index of the class, as returned by 
+*   OS_AddSchedulingClass().
+*/
+void OS_SetSchedulingClass(OS_TCB_t* const tcb, const uint32_t schedClass);
+
 /** 
 * @brief Starts the OS kernel. Never returns. 
 */
@@ -109,13 +215,21 @@ void OS_InitialiseTCB(OS_TCB_t * TCB,
                       void const * const data);
 
 /**
-* @brief SVC delegate to add a task. 
+* @brief SVC delegate to add a task. If the task has declared its timing with
+*   OS_SetTaskTiming(), the scheduler may reject it if the resulting task set 
+*   would not be schedulable.
 * @param tcb The tcb to add.
 * @param priority The priority that the task will hold. The list of priority 
 *   levels can be found in task.h.                      
+* @return OS_ADD_TASK_OK if the task was added.
+* @return OS_ADD_TASK_ERR_FULL if the scheduler cannot hold any more tasks.
+* @return OS_ADD_TASK_ERR_UNSCHEDULABLE if adding the task would cause a task
+*   to miss its deadline.
+* @return OS_ADD_TASK_ERR_INVALID if the task has a period but a zero wcet or
+*   deadline, or a deadline longer than its period.
 **/
-void __svc(OS_SVC_ADD_TASK) OS_AddTask(OS_TCB_t const * const tcb, 
-                                       const uint32_t priority);
+uint32_t __svc(OS_SVC_ADD_TASK) OS_AddTask(OS_TCB_t const * const tcb, 
+                                           const uint32_t priority);
 
 /**
 * @brief SVC delegate to put the current task into the wait state.
@@ -134,8 +248,69 @@ void __svc(OS_SVC_WAIT) OS_Wait(OS_tcbPriorityQueue_t* const waitingTaskQueue,
 */
 void __svc(OS_SVC_NOTIFY) OS_Notify(OS_tcbPriorityQueue_t* const waitingTaskQueue);
 
+/**
+* @brief SVC delegate to notify every task in a waiting tasks queue in a single
+*   call, rather than calling OS_Notify() once per task. 
+* @param waitingTaskQueue The queue whose tasks will all be notified.
+*/
+void __svc(OS_SVC_NOTIFY_ALL) OS_NotifyAll(OS_tcbPriorityQueue_t* const waitingTaskQueue);
+
+/**
+* @brief Notify a waiting tasks queue from an interrupt handler. An interrupt 
+*   handler must not make SVC calls, so the notification is deferred and made 
+*   by the OS the next time the scheduler runs, which is requested straight 
+*   away. It may also be called from thread mode, but OS_Notify() should be 
+*   preferred there. Up to OS_MAX_ISR_NOTIFIES notifications can be pending at 
+*   once.
+* @param waitingTaskQueue The queue to notify.
+* @return 1 if the notification was deferred.
+* @return 0 if too many notifications are already pending, in which case it is
+*   not made.
+*/
+uint32_t OS_NotifyFromISR(OS_tcbPriorityQueue_t* const waitingTaskQueue);
+
 void OS_Sleep(const uint32_t time);
 
+/**
+* @brief SVC delegate to change the priority of a task at runtime. If the task 
+*   is held in a priority queue, i.e. the running tasks queue, the sleeping 
+*   tasks queue or an object's waiting tasks queue, it is re-keyed in place in 
+*   O(log n), and the scheduler is invoked so the change takes effect 
+*   immediately.
+* @param tcb The task whose priority will be changed.
+* @param priority The new priority level. The list of priority levels can be 
+*   found in task.h.
+* @return OS_SET_PRIORITY_OK if the priority was changed.
+* @return OS_SET_PRIORITY_ERR_UNSCHEDULABLE if the scheduler rejected the 
+*   change because it would cause a task that has declared its timing to miss
+*   its deadline. The priority is left unchanged.
+*/
+uint32_t __svc(OS_SVC_SET_PRIORITY) OS_SetPriority(OS_TCB_t* const tcb, 
+                                                   const uint32_t priority);
+
+/**
+* @brief Mark the current job of the calling task as complete, and sleep until 
+*   the task's next release, which is one period after the release of the 
+*   current job. The response time of the job is recorded, and if it completed 
+*   after its deadline it is counted as a miss. If the next release has already 
+*   passed, the function returns immediately. The task must have declared its 
+*   timing with OS_SetTaskTiming(); if it has not, this simply yields.
+*/
+void OS_WaitNextPeriod(void);
+
+/**
+* @brief Install a function to be called whenever a task is found to have missed
+*   its deadline. Set to 0 to remove it.
+* @param hook The function to call. See OS_deadlineMissHook_t.
+*/
+void OS_SetDeadlineMissHook(const OS_deadlineMissHook_t hook);
+
+/**
+* @brief Returns the total number of deadline misses across all tasks since the 
+*   last reboot.
+*/
+uint32_t OS_GetDeadlineMissCount(void);
+
 /************************/
 /* Scheduling functions */
 /************************/
@@ -27,6 +27,9 @@ debug2
     IMPORT _svc_OS_schedule
     IMPORT _svc_OS_Wait
     IMPORT _svc_OS_Notify
+    IMPORT _svc_OS_SetPriority
+    IMPORT _svc_OS_NotifyAll
+    IMPORT _svc_OS_Call
     
 SVC_Handler
     ; Link register contains special 'exit handler mode' code
@@ -58,6 +61,9 @@ SVC_tableStart
     DCD _svc_OS_schedule
     DCD _svc_OS_Wait
     DCD _svc_OS_Notify
+    DCD _svc_OS_SetPriority
+    DCD _svc_OS_NotifyAll
+    DCD _svc_OS_Call
 SVC_tableEnd
 
     ALIGN
@@ -25,8 +25,34 @@ extern OS_TCB_t * volatile _currentTCB;
 /* svc */
 void __svc(OS_SVC_EXIT) _OS_task_exit(void);
 
+/* Calls a function in handler mode, for schedulers that must change their
+queues from thread mode without racing with the tick handler and PendSV. Tasks
+run unprivileged, so masking interrupts is not an option. The function must not
+make SVC calls. */
+void __svc(OS_SVC_CALL) _OS_Call(void (* const call)(void* const arg), void* const arg);
+
 /* C */
 void _OS_task_end(void);
+void _OS_SetPriority(OS_TCB_t* const tcb, const uint32_t priority);
+
+/* Defers a call from an interrupt handler to PendSV, where it is made before 
+the next task is chosen, so that it may change the scheduler's queues without 
+racing with them. Shares the OS_MAX_ISR_NOTIFIES slots of OS_NotifyFromISR(). 
+Returns 0 if every slot is in use. */
+uint32_t _OS_DeferToPendSV(void (* const call)(void* const arg), void* const arg);
+
+/* Atomically adds n to a word with LDREX/STREX. Used for the indices and 
+counters of the lock-free objects, such as the rings in spsc_channel.c and the
+statistics in slab.c. Pass (uint32_t)-1 to decrement. */
+void _OS_AtomicAdd(volatile uint32_t* const word, const uint32_t n);
+
+/* Wakes the task waiting in a lock-free object's waiting queue if the object's
+waiting flag is set, clearing the flag. See spsc_channel.c for the protocol. 
+From an interrupt handler the notification has to be deferred; if it cannot be,
+the flag is set again so that the next operation on the object retries it. It 
+is not retried from the tick; see spsc_channel.h. */
+void _OS_WakeIfWaiting(volatile uint32_t* const waiting, 
+                         OS_tcbPriorityQueue_t* const queue);
 
 /* asm */
 void _task_switch(void);
@@ -0,0 +1,336 @@
+#include "overload.h"
+
+#include "os.h"
+#include "os_internal.h"
+#include "fixedPriorityScheduler.h"
+
+/*
+The window is kept as a ring of OS_OVERLOAD_SLOTS slots, each recording the 
+idle ticks and deadline misses counted during it. At the end of each slot the 
+oldest slot is overwritten, the totals over the window are recalculated, and 
+the detector decides whether to apply or revert one policy.
+
+The policies are kept in _policies sorted by criticality, and the first 
+_nApplied of them are currently applied.
+*/
+
+static uint32_t  _idleTicks[OS_OVERLOAD_SLOTS];
+static uint32_t  _misses[OS_OVERLOAD_SLOTS];
+static uint32_t  _slot = 0;
+static uint32_t  _slotTicks = 0;
+static uint32_t  _lastMissCount = 0;
+
+static uint32_t  _idlePercent = 100;
+static volatile uint32_t  _overloaded = 0;
+
+static OS_shedPolicy_t*  _policies[OS_OVERLOAD_MAX_POLICIES];
+static uint32_t          _nPolicies = 0;
+static volatile uint32_t _nApplied = 0;
+
+static OS_itcQueue_t*  _queues[OS_OVERLOAD_MAX_QUEUES];
+static uint32_t        _queueThresholds[OS_OVERLOAD_MAX_QUEUES];
+static uint32_t        _nQueues = 0;
+
+static void OverloadTick(const uint32_t ticks);
+static void RetrySuspends(void);
+
+static OS_tickHook_t _tickHook = { OverloadTick, 0 };
+
+void OS_InitOverloadDetector(void)
+{
+    for (uint32_t i = 0; i < OS_OVERLOAD_SLOTS; i++)
+    {
+        // Start as if the system had been idle, so it is not considered 
+        // overloaded before a full window has been measured.
+        _idleTicks[i] = OS_OVERLOAD_SLOT_TICKS;
+        _misses[i] = 0;
+    }
+    
+    _slot = 0;
+    _slotTicks = 0;
+    _lastMissCount = OS_GetDeadlineMissCount();
+    _overloaded = 0;
+    _nApplied = 0;
+    
+    OS_AddTickHook(&_tickHook);
+}
+
+void OS_RegisterShedPolicy(OS_shedPolicy_t* const policy)
+{
+    ASSERT(_nPolicies < OS_OVERLOAD_MAX_POLICIES);
+    ASSERT(policy->Apply && policy->Revert);
+    
+    // Insert the policy in order of criticality.
+    uint32_t i = _nPolicies++;
+    while (i > 0 && _policies[i - 1]->criticality > policy->criticality)
+    {
+        _policies[i] = _policies[i - 1];
+        i--;
+    }
+    
+    _policies[i] = policy;
+}
+
+void OS_OverloadWatchQueue(OS_itcQueue_t* const queue, const uint32_t threshold)
+{
+    ASSERT(_nQueues < OS_OVERLOAD_MAX_QUEUES);
+    
+    _queues[_nQueues] = queue;
+    _queueThresholds[_nQueues] = threshold;
+    _nQueues++;
+}
+
+/* This function determines whether any watched queue is at or above its 
+threshold. */
+static uint32_t IsBacklogged(void)
+{
+    for (uint32_t i = 0; i < _nQueues; i++)
+    {
+        if (OS_ITCGetDepth(_queues[i]) >= _queueThresholds[i])
+        {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/* This function is called at the end of each slot to update the detector and 
+apply or revert one policy. */
+static void Evaluate(void)
+{
+    uint32_t idle = 0;
+    uint32_t misses = 0;
+    
+    for (uint32_t i = 0; i < OS_OVERLOAD_SLOTS; i++)
+    {
+        idle += _idleTicks[i];
+        misses += _misses[i];
+    }
+    
+    _idlePercent = (idle * 100) / (OS_OVERLOAD_SLOTS * OS_OVERLOAD_SLOT_TICKS);
+    uint32_t backlogged = IsBacklogged();
+    
+    if (misses > 0 || (_idlePercent < OS_OVERLOAD_IDLE_MIN_PERCENT && backlogged))
+    {
+        _overloaded = 1;
+    }
+    else if (_idlePercent >= OS_OVERLOAD_IDLE_CLEAR_PERCENT && !backlogged)
+    {
+        _overloaded = 0;
+    }
+    
+    if (_overloaded && _nApplied < _nPolicies)
+    {
+        OS_shedPolicy_t* policy = _policies[_nApplied++];
+        policy->Apply(policy);
+    }
+    else if (!_overloaded && _nApplied > 0)
+    {
+        // A policy that cannot be reverted yet stays applied, and is tried 
+        // again at the end of the next slot.
+        OS_shedPolicy_t* policy = _policies[_nApplied - 1];
+        if (policy->Revert(policy))
+        {
+            _nApplied--;
+        }
+    }
+}
+
+/* Counts the tick towards the current slot, and moves on to the next slot once
+the current one is full. */
+void OverloadTick(const uint32_t ticks)
+{
+    if (OS_CurrentTCB() == OS_idleTCB_p)
+    {
+        _idleTicks[_slot]++;
+    }
+    
+    RetrySuspends();
+    
+    if (++_slotTicks < OS_OVERLOAD_SLOT_TICKS)
+    {
+        return;
+    }
+    
+    uint32_t missCount = OS_GetDeadlineMissCount();
+    _misses[_slot] = missCount - _lastMissCount;
+    _lastMissCount = missCount;
+    
+    Evaluate();
+    
+    _slot = (_slot + 1) % OS_OVERLOAD_SLOTS;
+    _slotTicks = 0;
+    _idleTicks[_slot] = 0;
+    _misses[_slot] = 0;
+}
+
+uint32_t OS_IsOverloaded(void)
+{
+    return _overloaded;
+}
+
+uint32_t OS_OverloadGetIdlePercent(void)
+{
+    return _idlePercent;
+}
+
+uint32_t OS_OverloadGetShedLevel(void)
+{
+    return _nApplied;
+}
+
+/***************************/
+/* Built-in shed policies  */
+/***************************/
+
+static void DropMessagesApply(OS_shedPolicy_t* const policy)
+{
+    ((OS_itcQueue_t* )policy->target)->shedding = 1;
+}
+
+static uint32_t DropMessagesRevert(OS_shedPolicy_t* const policy)
+{
+    ((OS_itcQueue_t* )policy->target)->shedding = 0;
+    return 1;
+}
+
+static void LowerRateApply(OS_shedPolicy_t* const policy)
+{
+    OS_TCB_t* tcb = (OS_TCB_t* )policy->target;
+    policy->saved = tcb->timing.period;
+    tcb->timing.period *= policy->param;
+}
+
+static uint32_t LowerRateRevert(OS_shedPolicy_t* const policy)
+{
+    OS_TCB_t* tcb = (OS_TCB_t* )policy->target;
+    
+    // Tasks may have been admitted against the lowered rate, so the original 
+    // period may no longer fit.
+    if (!FPS_IsSchedulableWith(tcb, tcb->priority, policy->saved))
+    {
+        return 0;
+    }
+    
+    tcb->timing.period = policy->saved;
+    return 1;
+}
+
+/* This function brings a suspend policy's task in line with whether the 
+policy is wanted. It is deferred to PendSV, as changing a priority rebuilds the
+scheduler's queues, and so must not happen in the tick handler. It may be 
+called more than once for one change, so it does nothing once the task is in 
+line. */
+static void SuspendSync(void* const arg)
+{
+    OS_shedPolicy_t* policy = (OS_shedPolicy_t* )arg;
+    OS_TCB_t* tcb = (OS_TCB_t* )policy->target;
+    
+    if (policy->wanted && !policy->applied)
+    {
+        policy->saved = tcb->priority;
+        _OS_SetPriority(tcb, OS_SCHEDULER_PRIORITY_LVL_NONE);
+        policy->applied = 1;
+    }
+    else if (!policy->wanted && policy->applied)
+    {
+        // Leave the priority alone if something else, such as priority 
+        // inheritance, has changed it whilst the task was suspended.
+        if (tcb->priority == OS_SCHEDULER_PRIORITY_LVL_NONE)
+        {
+            _OS_SetPriority(tcb, policy->saved);
+        }
+        
+        policy->applied = 0;
+    }
+}
+
+static void SuspendApply(OS_shedPolicy_t* const policy)
+{
+    policy->wanted = 1;
+    _OS_DeferToPendSV(SuspendSync, policy);
+}
+
+static uint32_t SuspendRevert(OS_shedPolicy_t* const policy)
+{
+    OS_TCB_t* tcb = (OS_TCB_t* )policy->target;
+    
+    // The task is left out of the admission analysis whilst it is suspended, 
+    // so check that restoring its priority still fits. There is nothing to 
+    // check if the task was never suspended, or if its priority has been 
+    // changed by something else and so will not be restored.
+    if (policy->applied && 
+        tcb->priority == OS_SCHEDULER_PRIORITY_LVL_NONE &&
+        !FPS_IsSchedulableWith(tcb, policy->saved, tcb->timing.period))
+    {
+        return 0;
+    }
+    
+    policy->wanted = 0;
+    _OS_DeferToPendSV(SuspendSync, policy);
+    return 1;
+}
+
+/* This function defers the change of any suspend policy whose task is not in
+line with it, in case deferring it when it was applied or reverted failed 
+because every deferred call slot was in use. */
+static void RetrySuspends(void)
+{
+    for (uint32_t i = 0; i < _nPolicies; i++)
+    {
+        OS_shedPolicy_t* policy = _policies[i];
+        
+        if (policy->Apply == SuspendApply && policy->wanted != policy->applied)
+        {
+            _OS_DeferToPendSV(SuspendSync, policy);
+        }
+    }
+}
+
+void OS_InitShedDropMessages(OS_shedPolicy_t* const policy,
+                               OS_itcQueue_t* const queue,
+                               const uint32_t criticality)
+{
+    policy->criticality = criticality;
+    policy->Apply = DropMessagesApply;
+    policy->Revert = DropMessagesRevert;
+    policy->target = queue;
+    policy->param = 0;
+    policy->saved = 0;
+    policy->wanted = 0;
+    policy->applied = 0;
+}
+
+void OS_InitShedLowerRate(OS_shedPolicy_t* const policy,
+                            OS_TCB_t* const tcb,
+                            const uint32_t factor,
+                            const uint32_t criticality)
+{
+    // A factor of 0 would give a period of 0, which disables the task's timing
+    // checks, and a factor of 1 would not lower the rate at all.
+    ASSERT(factor >= 2);
+    
+    policy->criticality = criticality;
+    policy->Apply = LowerRateApply;
+    policy->Revert = LowerRateRevert;
+    policy->target = tcb;
+    policy->param = factor;
+    policy->saved = 0;
+    policy->wanted = 0;
+    policy->applied = 0;
+}
+
+void OS_InitShedSuspend(OS_shedPolicy_t* const policy,
+                          OS_TCB_t* const tcb,
+                          const uint32_t criticality)
+{
+    policy->criticality = criticality;
+    policy->Apply = SuspendApply;
+    policy->Revert = SuspendRevert;
+    policy->target = tcb;
+    policy->param = 0;
+    policy->saved = 0;
+    policy->wanted = 0;
+    policy->applied = 0;
+}
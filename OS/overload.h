@@ -0,0 +1,152 @@
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+#include <stdint.h>
+
+#include "task.h"
+#include "itc_queue.h"
+
+/*
+The overload detector measures, over a sliding window of the most recent 
+OS_OVERLOAD_SLOTS * OS_OVERLOAD_SLOT_TICKS ticks, the proportion of time spent 
+in the idle task and the number of deadline misses, and samples the depth of 
+every watched ITC queue at the end of each slot.
+
+The system is considered overloaded when any deadline was missed in the window,
+or when the idle time has fallen below OS_OVERLOAD_IDLE_MIN_PERCENT and a 
+watched queue is at or above its threshold. The overload clears once there have
+been no misses in the window, the idle time has recovered to at least 
+OS_OVERLOAD_IDLE_CLEAR_PERCENT and every watched queue is below its threshold. 
+The gap between the two idle percentages stops the detector flapping.
+
+Load shedding policies are registered with a criticality, and are applied in 
+order of criticality, least critical first, one at the end of each slot for as 
+long as the system remains overloaded. Once the overload clears, they are 
+reverted in the opposite order, again one per slot.
+
+Policies are applied and reverted from the system tick handler, so their 
+functions must be short and must not make any SVC calls. The built-in policies
+below satisfy this.
+*/
+
+#define OS_OVERLOAD_SLOTS               4
+#define OS_OVERLOAD_SLOT_TICKS          25
+#define OS_OVERLOAD_IDLE_MIN_PERCENT    5
+#define OS_OVERLOAD_IDLE_CLEAR_PERCENT  20
+#define OS_OVERLOAD_MAX_POLICIES        8
+#define OS_OVERLOAD_MAX_QUEUES          4
+
+/**
+* @brief This structure contains a single load shedding policy. It should be 
+*   initialised with one of the OS_InitShed functions below, or by filling in 
+*   the Apply and Revert fields for a custom policy, and then registered with 
+*   OS_RegisterShedPolicy().
+*/
+typedef struct s_ShedPolicy
+{
+    // The lower the criticality, the earlier the policy is applied.
+    uint32_t criticality;
+    
+    // Called, in handler mode, to apply and to revert the policy. They are 
+    // called from the system tick handler, so a policy that changes the 
+    // scheduler's queues must defer the change to PendSV. Revert returns 1 if
+    // the policy was reverted, or 0 if it must stay applied for now, in which 
+    // case it is tried again at the end of the next slot.
+    void (* Apply)(struct s_ShedPolicy* const policy);
+    uint32_t (* Revert)(struct s_ShedPolicy* const policy);
+    
+    // The object the policy acts on, a parameter, and storage for whatever 
+    // must be restored when the policy is reverted.
+    void*     target;
+    uint32_t  param;
+    uint32_t  saved;
+    
+    // Whether the policy should be applied, and whether it has been, for 
+    // policies whose effect is deferred.
+    volatile uint32_t  wanted;
+    volatile uint32_t  applied;
+} OS_shedPolicy_t;
+
+/**
+* @brief Initialise the overload detector and register its tick hook. This must
+*   be called before OS_Start().
+*/
+void OS_InitOverloadDetector(void);
+
+/**
+* @brief Register a load shedding policy. This must be called before 
+*   OS_Start(). At most OS_OVERLOAD_MAX_POLICIES policies may be registered.
+* @param policy Pointer to the statically allocated, initialised policy.
+*/
+void OS_RegisterShedPolicy(OS_shedPolicy_t* const policy);
+
+/**
+* @brief Watch the depth of an ITC queue as a measure of backlog. This must be
+*   called before OS_Start(). At most OS_OVERLOAD_MAX_QUEUES queues may be 
+*   watched.
+* @param queue Pointer to the queue to watch.
+* @param threshold The depth at and above which the queue counts as backlogged.
+*/
+void OS_OverloadWatchQueue(OS_itcQueue_t* const queue, const uint32_t threshold);
+
+/**
+* @brief Initialise a policy which drops messages sent to an ITC queue whilst 
+*   applied. See OS_ITCSendMsg().
+* @param policy The policy to initialise.
+* @param queue The queue whose messages will be dropped.
+* @param criticality The criticality of the policy.
+*/
+void OS_InitShedDropMessages(OS_shedPolicy_t* const policy,
+                               OS_itcQueue_t* const queue,
+                               const uint32_t criticality);
+
+/**
+* @brief Initialise a policy which lowers the rate of a periodic task whilst 
+*   applied, by multiplying its period. This takes effect from the task's next 
+*   call to OS_WaitNextPeriod(). Tasks may be admitted by the fixed-priority 
+*   scheduler against the lowered rate, so the policy is only reverted once the
+*   original period passes its admission analysis again.
+* @param policy The policy to initialise.
+* @param tcb The task, which must have declared its timing.
+* @param factor The factor to multiply the task's period by, at least 2.
+* @param criticality The criticality of the policy.
+*/
+void OS_InitShedLowerRate(OS_shedPolicy_t* const policy,
+                            OS_TCB_t* const tcb,
+                            const uint32_t factor,
+                            const uint32_t criticality);
+
+/**
+* @brief Initialise a policy which suspends a task whilst applied, by demoting
+*   it to OS_SCHEDULER_PRIORITY_LVL_NONE so that it only runs when nothing else
+*   can. Its priority is restored when the policy is reverted, unless it has 
+*   been changed by something else in the meantime. The change is made from 
+*   PendSV, shortly after the policy is applied or reverted. This is intended
+*   for use with the fixed-priority scheduler, which leaves the task out of its
+*   admission analysis whilst it is suspended. The policy is only reverted once
+*   the task's original priority passes the analysis again.
+* @param policy The policy to initialise.
+* @param tcb The task to suspend.
+* @param criticality The criticality of the policy.
+*/
+void OS_InitShedSuspend(OS_shedPolicy_t* const policy,
+                          OS_TCB_t* const tcb,
+                          const uint32_t criticality);
+
+/**
+* @brief Determine whether the system is currently considered overloaded.
+* @return 1 if the system is overloaded, 0 if it is not.
+*/
+uint32_t OS_IsOverloaded(void);
+
+/**
+* @brief Returns the percentage of the most recent window spent idle.
+*/
+uint32_t OS_OverloadGetIdlePercent(void);
+
+/**
+* @brief Returns the number of shedding policies currently applied.
+*/
+uint32_t OS_OverloadGetShedLevel(void);
+
+#endif  // OVERLOAD_H
@@ -0,0 +1,207 @@
+#include "partitionScheduler.h"
+
+#include "stm32f3xx.h"
+
+#include "os_internal.h"
+#include "tcb_priority_queue.h"
+#include "debugTools.h"
+
+/*
+Each partition has its own running and sleeping tasks queues, used exactly as 
+_runningTasksQueue and _sleepingTasksQueue are in the fixed-priority scheduler.
+A task that is notified is always returned to the running tasks queue of its 
+own partition, whichever partition notified it.
+
+The sleeping tasks of a partition are only woken whilst the partition may run,
+i.e. during its windows or when time is donated to it. There is no point waking
+them earlier, as they could not run anyway.
+*/
+
+typedef struct s_Partition
+{
+    OS_tcbPriorityQueue_t  runningTasksQueue;
+    OS_tcbPriorityQueue_t  sleepingTasksQueue;
+    OS_TCB_t*              runningTasks[MAX_TASKS];
+    OS_TCB_t*              sleepingTasks[MAX_TASKS];
+} OS_partition_t;
+
+static OS_partition_t  _partitions[PS_MAX_PARTITIONS];
+
+/* The major frame, the index of the current window and the number of ticks 
+left in it. */
+static const OS_partitionWindow_t*  _windows = 0;
+static size_t                       _nWindows = 0;
+static volatile uint32_t            _window = 0;
+static volatile uint32_t            _windowTicksLeft = 0;
+
+static uint32_t  _backgroundPartition = PS_NO_PARTITION;
+
+/* Scheduler callback function prototypes. */
+static const OS_TCB_t*  PS_SchedulerCallback(void); 
+static uint32_t  PS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority);
+static void  PS_TaskExitCallback(OS_TCB_t* const task);
+static void  PS_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue, OS_TCB_t* const tcb);
+static void  PS_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue);
+static void  PS_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time);
+static void  PS_TickCallback(const uint32_t ticks);
+
+OS_Scheduler_t const partitionScheduler = 
+{
+    .preemptive        = OS_PREEMPTIVE_SCHEDULING,
+    .SchedulerCallback = PS_SchedulerCallback,
+    .AddTaskCallback   = PS_AddTaskCallback,
+    .TaskExitCallback  = PS_TaskExitCallback,
+    .WaitCallback      = PS_TaskWaitCallback,
+    .NotifyCallback    = PS_TaskNotifyCallback,
+    .SleepCallback     = PS_TaskSleepCallback,
+    .TickCallback      = PS_TickCallback
+};
+
+void OS_InitPartitionScheduler(const OS_partitionWindow_t* const windows,
+                                 const size_t nWindows,
+                                 const uint32_t backgroundPartition)
+{
+    ASSERT(nWindows > 0);
+    
+    // A window of no ticks would wrap the count of ticks left in it.
+    for (uint32_t i = 0; i < nWindows; i++)
+    {
+        ASSERT(windows[i].duration > 0);
+        ASSERT(windows[i].partition < PS_MAX_PARTITIONS);
+    }
+    
+    for (uint32_t i = 0; i < PS_MAX_PARTITIONS; i++)
+    {
+        OS_InitTCBPriorityQueue(&_partitions[i].runningTasksQueue, _partitions[i].runningTasks, MAX_TASKS, TCBPQ_ORDER_BY_PRIORITY);
+        OS_InitTCBPriorityQueue(&_partitions[i].sleepingTasksQueue, _partitions[i].sleepingTasks, MAX_TASKS, TCBPQ_ORDER_BY_DATA);
+    }
+    
+    _windows = windows;
+    _nWindows = nWindows;
+    _window = 0;
+    _windowTicksLeft = windows[0].duration;
+    _backgroundPartition = backgroundPartition;
+}
+
+void OS_SetTaskPartition(OS_TCB_t* const tcb, const uint32_t partition)
+{
+    ASSERT(partition < PS_MAX_PARTITIONS);
+    tcb->partition = partition;
+}
+
+uint32_t OS_GetActivePartition(void)
+{
+    return _windows[_window].partition;
+}
+
+/* This function moves the tasks of a partition whose sleep time has elapsed 
+back into its running tasks queue. */
+static void UpdateSleepingTasks(OS_partition_t* const partition)
+{
+    uint32_t ticks = OS_ElapsedTicks();
+    OS_TCB_t* extracted = 0;
+    
+    while (!OS_TCBPriorityQueueEmpty(&partition->sleepingTasksQueue) &&
+           ticks > OS_TCBPriorityQueuePeek(&partition->sleepingTasksQueue)->data)
+    {
+        extracted = OS_TCBPriorityQueueExtract(&partition->sleepingTasksQueue);
+        extracted->data = 0;  // clear any data related to sleeping
+        OS_TCBPriorityQueueInsert(&partition->runningTasksQueue, extracted);
+    }
+}
+
+/* This function returns the highest priority task ready to run in a partition,
+or 0 if there is none. */
+static OS_TCB_t* PartitionPeek(const uint32_t partitionIndex)
+{
+    if (partitionIndex >= PS_MAX_PARTITIONS)
+    {
+        return 0;
+    }
+    
+    OS_partition_t* partition = &_partitions[partitionIndex];
+    UpdateSleepingTasks(partition);
+    return OS_TCBPriorityQueuePeek(&partition->runningTasksQueue);
+}
+
+const OS_TCB_t* PS_SchedulerCallback(void)
+{
+    OS_TCB_t* tcb = PartitionPeek(_windows[_window].partition);
+    
+    if (!tcb && _backgroundPartition != _windows[_window].partition)
+    {
+        // The window's partition has nothing ready to run, so donate the rest 
+        // of the window to the background partition.
+        tcb = PartitionPeek(_backgroundPartition);
+    }
+    
+    if (!tcb)
+    {
+        return OS_idleTCB_p;
+    }
+    
+    return tcb;
+}
+
+uint32_t PS_AddTaskCallback(OS_TCB_t* const newTask, const uint32_t priority)
+{
+    newTask->priority = priority;
+    
+    if (!OS_TCBPriorityQueueInsert(&_partitions[newTask->partition].runningTasksQueue, newTask))
+    {
+        return OS_ADD_TASK_ERR_FULL;
+    }
+    
+    return OS_ADD_TASK_OK;
+}
+
+void PS_TaskExitCallback(OS_TCB_t* const task)
+{
+    OS_TCBPriorityQueueRemove(&_partitions[task->partition].runningTasksQueue, task);
+}
+
+void PS_TaskWaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue,
+                           OS_TCB_t* const tcb)
+{
+    OS_TCBPriorityQueueRemove(&_partitions[tcb->partition].runningTasksQueue, tcb);
+    OS_TCBPriorityQueueInsert(waitingTaskQueue, tcb);
+    
+    // Set the PendSV to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void PS_TaskNotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue)
+{
+    OS_TCB_t* tcb = OS_TCBPriorityQueueExtract(waitingTaskQueue);
+    if (!tcb)
+    {
+        return;
+    }
+    
+    OS_TCBPriorityQueueInsert(&_partitions[tcb->partition].runningTasksQueue, tcb);
+    
+    // Set the PendSV bit to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+void PS_TaskSleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time)
+{
+    OS_partition_t* partition = &_partitions[tcb->partition];
+    
+    OS_TCBPriorityQueueRemove(&partition->runningTasksQueue, tcb);
+    OS_TCBPriorityQueueInsert(&partition->sleepingTasksQueue, tcb);
+    
+    OS_Yield();
+}
+
+/* Counts down the current window and moves on to the next when it ends. PendSV
+is set by the system tick handler after this returns, so the scheduler will run
+and switch to the new window's partition. */
+void PS_TickCallback(const uint32_t ticks)
+{
+    if (--_windowTicksLeft == 0)
+    {
+        _window = (_window + 1) % _nWindows;
+        _windowTicksLeft = _windows[_window].duration;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PARTITION_SCHEDULER
+#define PARTITION_SCHEDULER
+
+#include "os.h"
+
+/*
+The partition scheduler divides time between partitions in the style of ARINC 
+653. Every task belongs to one partition, and the major frame is a fixed, 
+repeating sequence of time windows, each of which belongs to one partition. 
+During a window, only tasks in that window's partition may run, and between 
+themselves they are scheduled by fixed priority, exactly as by the 
+fixed-priority scheduler. Windows are switched from the system tick, so a 
+partition that never blocks cannot take any time from the windows of another.
+
+If a background partition is given, then whenever the partition of the current
+window has no task ready to run, the remainder of the window is donated to the
+background partition instead of the idle task. A window belonging to 
+PS_NO_PARTITION is an idle window, which is only ever donated.
+
+Tasks are assigned to a partition with OS_SetTaskPartition() before they are 
+added with OS_AddTask(). Tasks belong to partition 0 by default.
+*/
+
+#define PS_MAX_PARTITIONS  4
+#define PS_NO_PARTITION    0xFFFFFFFFUL
+
+/**
+* @brief This structure contains a single time window in the major frame.
+*/
+typedef struct s_PartitionWindow
+{
+    // The partition whose tasks may run during the window, or PS_NO_PARTITION.
+    uint32_t partition;
+    
+    // The length of the window in ticks. This must not be 0.
+    uint32_t duration;
+} OS_partitionWindow_t;
+
+extern OS_Scheduler_t const partitionScheduler;
+
+/**
+* @brief Initialise the partition scheduler. This must be called before 
+*   OS_Start().
+* @param windows Pointer to an array of windows making up the major frame, in 
+*   the order they are to run. The array is not copied, so should be declared 
+*   static const.
+* @param nWindows The number of windows in the array.
+* @param backgroundPartition The partition that unused window time is donated 
+*   to, or PS_NO_PARTITION to leave unused time idle.
+*/
+void OS_InitPartitionScheduler(const OS_partitionWindow_t* const windows,
+                                 const size_t nWindows,
+                                 const uint32_t backgroundPartition);
+
+/**
+* @brief Assign a task to a partition. This must be called after 
+*   OS_InitialiseTCB() and before the task is added with OS_AddTask().
+* @param tcb The task in question.
+* @param partition The partition, from 0 to PS_MAX_PARTITIONS - 1.
+*/
+void OS_SetTaskPartition(OS_TCB_t* const tcb, const uint32_t partition);
+
+/**
+* @brief Returns the partition that owns the current window, or PS_NO_PARTITION
+*   if it is an idle window.
+*/
+uint32_t OS_GetActivePartition(void);
+
+#endif  // PARTITION_SCHEDULER
@@ -0,0 +1,114 @@
+#include "pipeline.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+/* The task of a stage, or of the first stage of a fused group. It runs each 
+item through the stages of its group in turn, and sends the result to the 
+group's output channel. */
+static void StageTask(void const* const args)
+{
+    OS_pipelineStage_t* first = (OS_pipelineStage_t* )args;
+    
+    while (1)
+    {
+        void* item = first->_in ? OS_SPSCReceive(first->_in) : 0;
+        OS_pipelineStage_t* stage = first;
+        
+        while (stage)
+        {
+            item = stage->Process(item, stage->context);
+            stage->stats.nIn++;
+            
+            if (!item)
+            {
+                break;
+            }
+            
+            if (stage->_sends)
+            {
+                if (OS_SPSCGetCount(&stage->_out) >= stage->_out.highWater)
+                {
+                    stage->stats.nStalls++;
+                }
+                
+                OS_SPSCSend(&stage->_out, item);
+            }
+            
+            if (stage->_sends || stage->_fusedNext)
+            {
+                stage->stats.nOut++;
+            }
+            
+            stage = stage->_fusedNext;
+        }
+    }
+}
+
+uint32_t OS_StartPipeline(OS_pipelineStage_t* const stages, 
+                            const uint32_t nStages,
+                            const uint32_t fusion)
+{
+    ASSERT(nStages > 0);
+    
+    // Decide which stages are fused, and connect the rest with channels.
+    for (uint32_t i = 0; i < nStages; i++)
+    {
+        OS_pipelineStage_t* stage = &stages[i];
+        OS_pipelineStage_t* next = (i + 1 < nStages) ? &stages[i + 1] : 0;
+        
+        stage->stats.nIn = 0;
+        stage->stats.nOut = 0;
+        stage->stats.nStalls = 0;
+        stage->_in = 0;
+        stage->_sends = 0;
+        stage->_fusedNext = 0;
+        
+        if (i > 0 && stages[i - 1]._sends)
+        {
+            stage->_in = &stages[i - 1]._out;
+        }
+        
+        if (!next)
+        {
+            break;
+        }
+        
+        if (fusion == OS_PIPELINE_FUSE && next->priority == stage->priority)
+        {
+            stage->_fusedNext = next;
+            continue;
+        }
+        
+        ASSERT(stage->outBuf);
+        OS_InitSPSCChannel(&stage->_out, stage->outBuf, stage->outCapacity);
+        if (stage->highWater)
+        {
+            OS_SPSCSetWatermarks(&stage->_out, stage->highWater, stage->lowWater);
+        }
+        
+        stage->_sends = 1;
+    }
+    
+    // Add a task for every stage that is not run by the stage before it.
+    for (uint32_t i = 0; i < nStages; i++)
+    {
+        OS_pipelineStage_t* stage = &stages[i];
+        
+        if (i > 0 && stages[i - 1]._fusedNext == stage)
+        {
+            continue;
+        }
+        
+        ASSERT(stage->stack);
+        OS_InitialiseTCB(&stage->_tcb, stage->stack + stage->stackWords, StageTask, stage);
+        
+        uint32_t status = OS_AddTask(&stage->_tcb, stage->priority);
+        if (status != OS_ADD_TASK_OK)
+        {
+            return status;
+        }
+    }
+    
+    return OS_ADD_TASK_OK;
+}
@@ -0,0 +1,112 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdint.h>
+
+#include "task.h"
+#include "spsc_channel.h"
+
+#define OS_PIPELINE_NO_FUSION  0
+#define OS_PIPELINE_FUSE       1
+
+/*
+A pipeline is a chain of stages, each of which takes an item from the stage 
+before it, processes it, and passes the result on to the stage after it. The 
+application describes the pipeline as a statically allocated array of stage 
+descriptors and starts it with OS_StartPipeline(), which connects the stages 
+with SPSC channels and creates a task for each stage.
+
+The first stage is the source: it is given no item and returns a new one, for 
+example by reading a sensor, and may sleep or wait to pace the pipeline. The 
+last stage is the sink, and whatever it returns is discarded. Any other stage 
+may return 0 to filter an item out, so nothing is passed on.
+
+Each channel applies backpressure through its watermarks, so a stage that gets
+ahead of the next one waits until the next stage has caught up to the low 
+watermark, rather than switching back and forth once per item.
+
+If fusion is requested, adjacent stages with the same priority run in a single
+task: an item is passed from one to the next by a direct call rather than 
+through a channel, so no context switches are needed between them. Only the 
+first stage of a fused group needs a stack.
+*/
+
+/**
+* @brief The function of a stage.
+* @param item The item from the previous stage, or 0 for the source.
+* @param context The stage's context pointer.
+* @return The item to pass to the next stage, or 0 to pass nothing on.
+*/
+typedef void* (* OS_stageFunc_t)(void* item, void* context);
+
+/**
+* @brief This structure holds the throughput counters of a stage.
+*/
+typedef struct s_StageStats
+{
+    // The number of items the stage has processed, and passed on. Items that 
+    // were filtered out are counted in nIn but not in nOut.
+    volatile uint32_t  nIn;
+    volatile uint32_t  nOut;
+    
+    // The number of times the stage's output channel had reached its high 
+    // watermark when the stage came to send an item, so the stage waited.
+    volatile uint32_t  nStalls;
+} OS_stageStats_t;
+
+/**
+* @brief This structure describes a single stage of a pipeline. The fields 
+*   above the line are set by the application, the rest by 
+*   OS_StartPipeline().
+*/
+typedef struct s_PipelineStage
+{
+    OS_stageFunc_t  Process;
+    void*           context;
+    uint32_t        priority;
+    
+    // The stack of the stage's task, which must be 8 byte aligned. It may be 0
+    // for a stage that is fused with the stage before it.
+    uint32_t*       stack;
+    uint32_t        stackWords;
+    
+    // The buffer of the channel to the next stage, its capacity, which must be
+    // a power of two, and its watermarks. These are not needed for the sink, 
+    // or for a stage that is fused with the stage after it. If both 
+    // watermarks are 0, the channel only applies backpressure when full.
+    void**          outBuf;
+    uint32_t        outCapacity;
+    uint32_t        highWater;
+    uint32_t        lowWater;
+    
+    /* ------------------------------------------------------------------- */
+    
+    OS_stageStats_t  stats;
+    
+    OS_TCB_t                  _tcb;
+    OS_spscChannel_t          _out;
+    OS_spscChannel_t*         _in;
+    
+    // 1 if the stage sends to its output channel, i.e. it is neither the sink 
+    // nor fused with the next stage.
+    uint32_t                  _sends;
+    
+    // The next stage, if it runs in this stage's task.
+    struct s_PipelineStage*   _fusedNext;
+} OS_pipelineStage_t;
+
+/**
+* @brief Connect the stages of a pipeline and add a task for each stage, or for
+*   each fused group of stages. This must be called before OS_Start().
+* @param stages The array of stages, source first.
+* @param nStages The number of stages, at least 1.
+* @param fusion OS_PIPELINE_FUSE to run adjacent stages with the same priority 
+*   in one task, or OS_PIPELINE_NO_FUSION to give every stage its own task.
+* @return OS_ADD_TASK_OK if every task was added, otherwise the status of the 
+*   first task that could not be added. See OS_AddTask().
+*/
+uint32_t OS_StartPipeline(OS_pipelineStage_t* const stages, 
+                            const uint32_t nStages,
+                            const uint32_t fusion);
+
+#endif  // PIPELINE_H
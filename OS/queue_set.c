@@ -0,0 +1,149 @@
+#include "queue_set.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+/*
+A task waiting on a set takes the check code before checking its members. Every
+member changes the check code when it becomes ready: an ITC queue when its mutex
+is released, and a semaphore when it notifies its own waiting queue. So if a 
+member becomes ready after the check, the wait is aborted, and if the task is 
+already waiting, the member's signal wakes it.
+
+Timeouts are checked by a tick hook. As the hook runs in handler mode, it wakes
+the task with OS_NotifyFromISR().
+*/
+
+static OS_queueSet_t* _sets[QS_MAX_SETS];
+static uint32_t _nSets = 0;
+
+static void QueueSetTick(const uint32_t ticks);
+
+static OS_tickHook_t _tickHook = { QueueSetTick, 0 };
+
+void OS_InitQueueSet(OS_queueSet_t* const set)
+{
+    ASSERT(_nSets < QS_MAX_SETS);
+    
+    set->nMembers = 0;
+    set->timeoutActive = 0;
+    set->deadline = 0;
+    OS_InitTCBPriorityQueue(&set->_waitingTaskQueue, set->_waitingTasks, 1, TCBPQ_ORDER_BY_PRIORITY);
+    
+    if (_nSets == 0)
+    {
+        OS_AddTickHook(&_tickHook);
+    }
+    
+    _sets[_nSets++] = set;
+}
+
+/* This function adds an object to the set's members and returns its index. */
+static int32_t AddMember(OS_queueSet_t* const set, 
+                           const uint32_t type, 
+                           void* const object)
+{
+    ASSERT(set->nMembers < QS_MAX_MEMBERS);
+    
+    set->members[set->nMembers].type = type;
+    set->members[set->nMembers].object = object;
+    
+    return set->nMembers++;
+}
+
+int32_t OS_QueueSetAddITC(OS_queueSet_t* const set, 
+                            OS_itcQueue_t* const queue, 
+                            OS_TCB_t* const tcb)
+{
+    OS_itcMailbox_t* mailbox = OS_ITCGetMailbox(queue, tcb);
+    
+    ASSERT(mailbox && mailbox->set == 0);
+    mailbox->set = set;
+    
+    return AddMember(set, QS_MEMBER_ITC, mailbox);
+}
+
+int32_t OS_QueueSetAddSemaphore(OS_queueSet_t* const set, OS_sem_t* const sem)
+{
+    ASSERT(sem->set == 0);
+    sem->set = set;
+    
+    return AddMember(set, QS_MEMBER_SEM, sem);
+}
+
+/* This function returns the index of the first ready member, or -1 if none is
+ready. */
+static int32_t FindReady(OS_queueSet_t* const set)
+{
+    for (uint32_t i = 0; i < set->nMembers; i++)
+    {
+        OS_queueSetMember_t* member = &set->members[i];
+        
+        if (member->type == QS_MEMBER_ITC)
+        {
+            if (((OS_itcMailbox_t* )member->object)->ready)
+            {
+                return i;
+            }
+        }
+        else if (OS_SemaphoreGetCount((OS_sem_t* )member->object) > 0)
+        {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+int32_t OS_QueueSetWait(OS_queueSet_t* const set, const uint32_t timeout)
+{
+    if (timeout != QS_WAIT_FOREVER)
+    {
+        set->deadline = OS_ElapsedTicks() + timeout;
+        set->timeoutActive = 1;
+    }
+    
+    while (1)
+    {
+        uint32_t checkCode = OS_GetCheckCode();
+        int32_t ready = FindReady(set);
+        
+        if (ready != -1)
+        {
+            set->timeoutActive = 0;
+            return ready;
+        }
+        
+        if (set->timeoutActive && (int32_t)(OS_ElapsedTicks() - set->deadline) >= 0)
+        {
+            set->timeoutActive = 0;
+            return -1;
+        }
+        
+        OS_Wait(&set->_waitingTaskQueue, checkCode);
+    }
+}
+
+void OS_QueueSetSignal(OS_queueSet_t* const set)
+{
+    if (set->_waitingTaskQueue.length)
+    {
+        OS_Notify(&set->_waitingTaskQueue);
+    }
+}
+
+/* Wakes the owner of every set whose timeout has expired. */
+void QueueSetTick(const uint32_t ticks)
+{
+    for (uint32_t i = 0; i < _nSets; i++)
+    {
+        OS_queueSet_t* set = _sets[i];
+        
+        if (set->timeoutActive 
+            && (int32_t)(ticks - set->deadline) >= 0
+            && set->_waitingTaskQueue.length)
+        {
+            OS_NotifyFromISR(&set->_waitingTaskQueue);
+        }
+    }
+}
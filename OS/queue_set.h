@@ -0,0 +1,110 @@
+#ifndef QUEUE_SET_H
+#define QUEUE_SET_H
+
+#include <stdint.h>
+
+#include "task.h"
+#include "semaphore.h"
+#include "itc_queue.h"
+#include "tcb_priority_queue.h"
+
+#define QS_MAX_MEMBERS    8
+#define QS_MAX_SETS       4
+#define QS_WAIT_FOREVER   0xFFFFFFFF
+
+#define QS_MEMBER_ITC     1
+#define QS_MEMBER_SEM     2
+
+/*
+A queue set lets one task wait on several ITC mailboxes and semaphores at once,
+with an optional timeout. Each member holds a pointer to the set, and whenever 
+a member might have become ready it signals the set, which wakes the task. A 
+task waiting on a set is held in the set's waiting queue only, so a single 
+wakeup is enough whichever member became ready.
+
+OS_QueueSetWait() only reports which member is ready; the task must then read 
+the message or acquire the semaphore as usual. An object may be a member of at 
+most one set.
+*/
+
+/**
+* @brief This structure contains a single member of a queue set.
+*/
+typedef struct s_QueueSetMember
+{
+    // QS_MEMBER_ITC or QS_MEMBER_SEM.
+    uint32_t  type;
+    
+    // The mailbox or semaphore.
+    void*     object;
+} OS_queueSetMember_t;
+
+/**
+* @brief This structure contains a single queue set. It must be initialised 
+*   with OS_InitQueueSet() before use.
+*/
+typedef struct s_QueueSet
+{
+    OS_queueSetMember_t  members[QS_MAX_MEMBERS];
+    uint32_t             nMembers;
+    
+    // Whilst the owner waits with a timeout, timeoutActive is set and deadline
+    // holds the tick at which the wait times out.
+    volatile uint32_t  timeoutActive;
+    volatile uint32_t  deadline;
+    
+    // Only the task that owns the set waits on it.
+    OS_tcbPriorityQueue_t  _waitingTaskQueue;
+    OS_TCB_t*              _waitingTasks[1];
+} OS_queueSet_t;
+
+/**
+* @brief Initialise a queue set. At most QS_MAX_SETS sets may be initialised. 
+*   This must be called before OS_Start().
+* @param set Pointer to the set to initialise.
+*/
+void OS_InitQueueSet(OS_queueSet_t* const set);
+
+/**
+* @brief Add a task's mailbox in an ITC queue to a queue set. The member is 
+*   ready whenever the mailbox holds a message.
+* @param set Pointer to the set.
+* @param queue Pointer to the ITC queue.
+* @param tcb Pointer to the task that owns the set and will read the mailbox.
+* @return The index of the member, which OS_QueueSetWait() returns when it is 
+*   ready.
+*/
+int32_t OS_QueueSetAddITC(OS_queueSet_t* const set, 
+                            OS_itcQueue_t* const queue, 
+                            OS_TCB_t* const tcb);
+
+/**
+* @brief Add a semaphore to a queue set. The member is ready whenever the 
+*   semaphore has a resource available.
+* @param set Pointer to the set.
+* @param sem Pointer to the semaphore.
+* @return The index of the member, which OS_QueueSetWait() returns when it is 
+*   ready.
+*/
+int32_t OS_QueueSetAddSemaphore(OS_queueSet_t* const set, OS_sem_t* const sem);
+
+/**
+* @brief Wait until any member of a queue set is ready, or the timeout expires.
+*   If several members are ready, the one added first is returned.
+* @param set Pointer to the set.
+* @param timeout The maximum number of ticks to wait. 0 checks the members 
+*   without waiting, and QS_WAIT_FOREVER waits with no timeout.
+* @return The index of a ready member.
+* @return -1 if the timeout expired first.
+*/
+int32_t OS_QueueSetWait(OS_queueSet_t* const set, const uint32_t timeout);
+
+/**
+* @brief Wake the task waiting on a queue set, if any. This is called by the 
+*   members of the set when they may have become ready, and need not be called
+*   by the application.
+* @param set Pointer to the set.
+*/
+void OS_QueueSetSignal(OS_queueSet_t* const set);
+
+#endif  // QUEUE_SET_H
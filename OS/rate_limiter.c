@@ -0,0 +1,121 @@
+#include "rate_limiter.h"
+
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+/* Every initialised rate limiter, so that the tick hook can clamp them. */
+static OS_rateLimiter_t* _limiters[RL_MAX_LIMITERS];
+static uint32_t _nLimiters = 0;
+
+static void RateLimiterTick(const uint32_t ticks);
+
+static OS_tickHook_t _tickHook = { RateLimiterTick, 0 };
+
+void OS_InitRateLimiter(OS_rateLimiter_t* const limiter, 
+                          const uint32_t rate, 
+                          const uint32_t burst)
+{
+    ASSERT(rate > 0 && rate <= 1000 * RL_SUBTICKS && burst > 0);
+    ASSERT((uint64_t)burst * (1000 * RL_SUBTICKS) / rate < (1UL << 30));
+    ASSERT(_nLimiters < RL_MAX_LIMITERS);
+    
+    limiter->interval = (1000 * RL_SUBTICKS) / rate;
+    limiter->tolerance = (burst - 1) * limiter->interval;
+    
+    // The bucket is full once the current time has passed the time it would be
+    // empty by the whole burst.
+    limiter->emptyAt = OS_ElapsedTicks() * RL_SUBTICKS - limiter->tolerance - limiter->interval;
+    
+    if (_nLimiters == 0)
+    {
+        OS_AddTickHook(&_tickHook);
+    }
+    
+    _limiters[_nLimiters++] = limiter;
+}
+
+/* This tick hook moves the empty time of every full bucket forward to the 
+earliest time at which the bucket is full, so that it never falls 2^31 
+thousandths of a tick behind the current time. A task updating the empty time 
+at the same moment loses its reservation, as taking the exception clears it, 
+and retries with the clamped time. */
+static void RateLimiterTick(const uint32_t ticks)
+{
+    if (ticks & (RL_CLAMP_PERIOD - 1))
+    {
+        return;
+    }
+    
+    uint32_t now = ticks * RL_SUBTICKS;
+    
+    for (uint32_t i = 0; i < _nLimiters; i++)
+    {
+        OS_rateLimiter_t* limiter = _limiters[i];
+        uint32_t full = now - limiter->tolerance - limiter->interval;
+        
+        // A higher priority interrupt handler may take tokens part way 
+        // through, so the update must be exclusive here too.
+        do
+        {
+            if ((int32_t)(__LDREXW((uint32_t* )&limiter->emptyAt) - full) >= 0)
+            {
+                __CLREX();
+                break;
+            }
+        } while (__STREXW(full, (uint32_t* )&limiter->emptyAt));
+    }
+}
+
+/* This function attempts to take n tokens. If there are not enough, it returns
+the number of thousandths of a tick until there will be, otherwise 0. */
+static uint32_t TryTake(OS_rateLimiter_t* const limiter, const uint32_t n)
+{
+    uint32_t now = OS_ElapsedTicks() * RL_SUBTICKS;
+    uint32_t cost = n * limiter->interval;
+    uint32_t emptyAt;
+    
+    ASSERT(n > 0 && cost <= limiter->tolerance + limiter->interval);
+    
+    do
+    {
+        emptyAt = __LDREXW((uint32_t* )&limiter->emptyAt);
+        
+        // An empty time in the past means the bucket has been full since then.
+        if ((int32_t)(emptyAt - now) < 0)
+        {
+            emptyAt = now;
+        }
+        
+        // The tokens can be taken if doing so does not move the empty time 
+        // more than the whole bucket into the future.
+        int32_t excess = (int32_t)(emptyAt + cost - now) - (int32_t)(limiter->tolerance + limiter->interval);
+        if (excess > 0)
+        {
+            __CLREX();
+            return excess;
+        }
+    } while (__STREXW(emptyAt + cost, (uint32_t* )&limiter->emptyAt));
+    
+    return 0;
+}
+
+uint32_t OS_RateLimiterTryAcquire(OS_rateLimiter_t* const limiter, const uint32_t n)
+{
+    return TryTake(limiter, n) == 0;
+}
+
+void OS_RateLimiterAcquire(OS_rateLimiter_t* const limiter, const uint32_t n)
+{
+    uint32_t wait;
+    
+    while ((wait = TryTake(limiter, n)) != 0)
+    {
+        // Round up to the tick at which there will be enough tokens. 
+        // OS_Sleep(t) wakes on the (t + 1)th tick from now, so sleep for one 
+        // tick less.
+        uint32_t ticks = (wait + RL_SUBTICKS - 1) / RL_SUBTICKS;
+        OS_Sleep(ticks - 1);
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <stdint.h>
+
+/*
+A rate limiter is a token bucket: it holds up to burst tokens, refills at rate 
+tokens per 1000 ticks, and each operation it limits takes tokens from it. 
+
+Rather than a token count and the time it was last refilled, which would need 
+updating together, the bucket is held as a single word: the time at which it 
+would be empty if it were not refilled any further, in thousandths of a tick. 
+Taking a token moves this time on by one token's worth, and refilling happens 
+implicitly as the current time catches up with it. The word is updated with 
+LDREX/STREX, so no lock is needed and the limiter may be shared by any number 
+of tasks, and tried from interrupt handlers.
+
+The empty time is compared with the current time modulo 2^32 thousandths of a 
+tick, which is only correct whilst they are less than 2^31 apart, about 35 
+minutes at 1000 ticks a second. A limiter idle for longer would appear empty, 
+so every RL_CLAMP_PERIOD ticks a tick hook moves the empty time of each full 
+bucket forward to the earliest time at which it is still full. This does not 
+change how many tokens there are, and keeps the times well within range.
+*/
+
+#define RL_SUBTICKS      1000
+#define RL_MAX_LIMITERS  8
+
+// How often full buckets are clamped, in ticks. This must be a power of two.
+#define RL_CLAMP_PERIOD  (1UL << 16)
+
+/**
+* @brief This structure contains a single rate limiter. It must be initialised 
+*   with OS_InitRateLimiter() before use.
+*/
+typedef struct s_RateLimiter
+{
+    // The time a token takes to refill, and the time the whole burst takes to
+    // refill, less one token, both in thousandths of a tick.
+    uint32_t  interval;
+    uint32_t  tolerance;
+    
+    // The time at which the bucket would be empty, in thousandths of a tick.
+    volatile uint32_t  emptyAt;
+} OS_rateLimiter_t;
+
+/**
+* @brief Initialise a rate limiter, with the bucket full. At most 
+*   RL_MAX_LIMITERS rate limiters may be initialised.
+* @param limiter Pointer to the rate limiter to initialise.
+* @param rate The number of tokens added per 1000 ticks, from 1 to 1000000.
+* @param burst The maximum number of tokens the bucket holds, at least 1. 
+*   burst * 1000000 / rate must be less than 2^30, so that the whole bucket
+*   plus one clamping period is less than 2^31 thousandths of a tick.
+*/
+void OS_InitRateLimiter(OS_rateLimiter_t* const limiter, 
+                          const uint32_t rate, 
+                          const uint32_t burst);
+
+/**
+* @brief Take tokens from a rate limiter if there are enough, without waiting.
+*   This may be called from an interrupt handler.
+* @param limiter Pointer to the rate limiter.
+* @param n The number of tokens to take, from 1 to the burst.
+* @return 1 if the tokens were taken.
+* @return 0 if there were not enough tokens, in which case none are taken.
+*/
+uint32_t OS_RateLimiterTryAcquire(OS_rateLimiter_t* const limiter, const uint32_t n);
+
+/**
+* @brief Take tokens from a rate limiter, sleeping until the tick at which 
+*   there will be enough if there are not enough now. This must only be called
+*   by a task.
+* @param limiter Pointer to the rate limiter.
+* @param n The number of tokens to take, from 1 to the burst.
+*/
+void OS_RateLimiterAcquire(OS_rateLimiter_t* const limiter, const uint32_t n);
+
+#endif  // RATE_LIMITER_H
@@ -3,6 +3,7 @@
 #include "cmsis_armcc.h"
 
 #include "os.h"
+#include "queue_set.h"
 #include "debugTools.h"
 
 void OS_InitSemaphore(OS_sem_t* const sem, const size_t nResources)  
@@ -10,6 +11,7 @@ void OS_InitSemaphore(OS_sem_t* const sem, const size_t nResources)
     sem->counter     = nResources;
     sem->nResources  = nResources;
     OS_InitTCBPriorityQueue(&sem->_waitingTasksQueue, sem->_waitingTasks, MAX_TASKS, TCBPQ_ORDER_BY_PRIORITY);
+    sem->set = 0;
 }
 
 void OS_SemaphoreAquire(OS_sem_t* const sem)
@@ -71,6 +73,11 @@ void OS_SemaphoreRelease(OS_sem_t* const sem)
         // There are free resources available now so notify any tasks that are
         // waiting to aquire the resource.
         OS_Notify(&sem->_waitingTasksQueue);
+        
+        if (sem->set)
+        {
+            OS_QueueSetSignal(sem->set);
+        }
     }
 }
 
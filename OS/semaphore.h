@@ -27,6 +27,9 @@ typedef struct s_OS_semaphore
     
     // This field stores the waiting tasks in the task queue.
     OS_TCB_t*              _waitingTasks[MAX_TASKS];
+    
+    // The queue set the semaphore is a member of, if any. See queue_set.h.
+    struct s_QueueSet*     set;
 } OS_sem_t;
 
 /** 
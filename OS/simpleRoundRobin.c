@@ -1,112 +1,236 @@
-//#include "simpleRoundRobin.h"
-
-//#include "stm32f3xx.h"
-//#include "debugTools.h"
-
-///* This is an implementation of an extremely simple (and inefficient!) 
-//round-robin scheduler.
-
-//An array of pointers to TCBs is declared, and when tasks are added they are 
-//inserted into this array.  When tasks finish, they are removed from the array 
-//(pointers are set back to zero). When the scheduler is invoked, it simply looks 
-//for the next available non-zero pointer in the array, and returns it.  If there 
-//are no non-zero TCB pointers in the array, a pointer to the idle task is 
-//returned instead.
-//	 
-//The inefficiency in this implementation arises mainly from the way arrays are 
-//used for list storage. If the array is large and the number of tasks is small, 
-//the scheduler will spend a lot of time looking through the array each time it 
-//is called. */
-
-//static OS_TCB_t* _tasks[SRR_MAX_TASKS] = { 0 };
-
-///* Scheduler callback function prototypes. */
-//static const OS_TCB_t*  SRR_SchedulerCallback(void);
-//static void  SRR_AddTaskCallback(OS_TCB_t * const tcb, const uint32_t priority);
-//static void  SRR_TaskExitCallback(OS_TCB_t * const tcb);
-//static void  SRR_WaitCallback(void* const reason, const uint32_t checkCode);
-//static void  SRR_NotifyCallback(void* const reason);
-
-//OS_Scheduler_t const simpleRoundRobinScheduler = {
-//	.preemptive        = OS_PREEMPTIVE_SCHEDULING,
-//    .type              = 2,
-//	.SchedulerCallback = SRR_SchedulerCallback,
-//	.AddTaskCallback   = SRR_AddTaskCallback,
-//	.TaskExitCallback  = SRR_TaskExitCallback,
-//    .WaitCallback      = SRR_WaitCallback,
-//    .NotifyCallback    = SRR_NotifyCallback
-//};
-
-//static const OS_TCB_t * SRR_SchedulerCallback(void) 
-//{
-//	static int i = 0;
-//	// Clear the yield flag if it's set - we simply don't care
-//	OS_CurrentTCB()->state &= ~TASK_STATE_YIELD;
-//	for (int j = 1; j <= SRR_MAX_TASKS; j++) 
-//    {
-//		i = (i + 1) % SRR_MAX_TASKS;
-//		if (_tasks[i] != 0 && 
-//              !IsTaskSleeping(_tasks[i], OS_ElapsedTicks()) &&
-//              !IsTaskWaiting(_tasks[i]->state))
-//        {
-//			return _tasks[i];
-//		}
-//	}
-//    
-//	// No tasks in the list, so return the idle task
-//	return OS_idleTCB_p;
-//}
-
-//static void SRR_AddTaskCallback(OS_TCB_t * const tcb, const uint32_t priority) 
-//{
-//	for (int i = 0; i < SRR_MAX_TASKS; i++) 
-//    {
-//		if (_tasks[i] == 0) 
-//        {
-//			_tasks[i] = tcb;
-//			return;
-//		}
-//	}
-//    
-//	// If we get here, there are no free TCB slots, so the task just won't be added
-//}
-
-//static void SRR_TaskExitCallback(OS_TCB_t * const tcb) {
-//	// Remove the given TCB from the list of tasks so it won't be run again
-//	for (int i = 0; i < SRR_MAX_TASKS; i++) 
-//    {
-//		if (_tasks[i] == tcb) 
-//        {
-//			_tasks[i] = 0;
-//		}
-//	}	
-//}
-
-//static void SRR_WaitCallback(void* const reason, const uint32_t checkCode) 
-//{
-//    OS_CurrentTCB()->data = (uint32_t)reason;
-//    
-//    // Set the PendSV to invoke the scheduler.
-//    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;   
-//}
-
-//static void SRR_NotifyCallback(void* const reason) 
-//{
-//    for (int i = 0; i < SRR_MAX_TASKS; i++)
-//    {
-//        if (_tasks[i] == NULL)
-//            continue;
-//        
-//        // Currently this function only notifies tcbs in the wait state. It 
-//        // needs to also notify sleeping tasks.
-//        if (_tasks[i]->data == (uint32_t)reason && 
-//            IsTaskWaiting(_tasks[i]->state)) 
-//        {
-//            _tasks[i]->state &= ~TASK_STATE_WAIT;
-//            _tasks[i]->data = NULL;
-//        }
-//    }
-//    
-//    // Set the PendSV bit to invoke the scheduler.
-//    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
-//}
+#include "simpleRoundRobin.h"
+
+#include "stm32f3xx.h"
+
+#include "tcb_priority_queue.h"
+#include "os_internal.h"
+#include "debugTools.h"
+
+/* 
+The ready tasks are kept in a circular, doubly-linked list threaded through the
+next and prev fields of their TCBs, and _head points at the task whose turn it 
+currently is. Moving on to the next task is a single pointer update, and so is 
+adding or removing a task.
+
+Only ready tasks are in the list. When a task waits, it is removed from the 
+list and put into the object's waiting tasks queue, and when it sleeps it is 
+removed from the list and put into _sleepingTasksQueue, ordered by wake time as 
+in the fixed-priority scheduler. Tasks are added back at the end of the list, 
+i.e. just before _head, when they are notified or woken. The scheduler 
+therefore never has to skip over blocked tasks.
+
+The list is rotated by the tick handler, so it is only changed in handler mode.
+The sleep callback is the one callback made in thread mode, so it moves the 
+task through an SVC rather than touching the list directly.
+*/
+
+static OS_TCB_t*           _head = 0;
+static uint32_t            _nTasks = 0;
+
+static uint32_t            _quantum = SRR_DEFAULT_QUANTUM;
+static volatile uint32_t   _quantumLeft = SRR_DEFAULT_QUANTUM;
+
+static OS_tcbPriorityQueue_t  _sleepingTasksQueue;
+static OS_TCB_t*              _sleepingTasks[SRR_MAX_TASKS];
+
+/* Scheduler callback function prototypes. */
+static const OS_TCB_t*  SRR_SchedulerCallback(void);
+static uint32_t  SRR_AddTaskCallback(OS_TCB_t* const tcb, const uint32_t priority);
+static void  SRR_TaskExitCallback(OS_TCB_t* const tcb);
+static void  SRR_WaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue, OS_TCB_t* const tcb);
+static void  SRR_NotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue);
+static void  SRR_SleepCallback(OS_TCB_t* const tcb, const uint32_t currentTime, const uint32_t time);
+static void  SRR_TickCallback(const uint32_t ticks);
+
+OS_Scheduler_t const simpleRoundRobinScheduler = 
+{
+	.preemptive        = OS_PREEMPTIVE_SCHEDULING,
+	.SchedulerCallback = SRR_SchedulerCallback,
+	.AddTaskCallback   = SRR_AddTaskCallback,
+	.TaskExitCallback  = SRR_TaskExitCallback,
+    .WaitCallback      = SRR_WaitCallback,
+    .NotifyCallback    = SRR_NotifyCallback,
+    .SleepCallback     = SRR_SleepCallback,
+    .TickCallback      = SRR_TickCallback
+};
+
+void OS_InitSRR(const uint32_t quantum)
+{
+    _head = 0;
+    _nTasks = 0;
+    _quantum = quantum ? quantum : SRR_DEFAULT_QUANTUM;
+    _quantumLeft = _quantum;
+    OS_InitTCBPriorityQueue(&_sleepingTasksQueue, _sleepingTasks, SRR_MAX_TASKS, TCBPQ_ORDER_BY_DATA);
+}
+
+/* This function adds a task to the end of the list of ready tasks. A yield 
+made just before the task left the list, e.g. to sleep, must not cost it its 
+next turn, so its yield flag is cleared. */
+static void ListAppend(OS_TCB_t* const tcb)
+{
+    tcb->state &= ~TASK_STATE_YIELD;
+    
+    if (!_head)
+    {
+        tcb->next = tcb->prev = tcb;
+        _head = tcb;
+        _quantumLeft = _quantum;
+        return;
+    }
+    
+    tcb->prev = _head->prev;
+    tcb->next = _head;
+    _head->prev->next = tcb;
+    _head->prev = tcb;
+}
+
+/* This function removes a task from the list of ready tasks. If it was the 
+task whose turn it was, the next task's turn starts. */
+static void ListRemove(OS_TCB_t* const tcb)
+{
+    if (!tcb->next)
+    {
+        return;  // not in the list
+    }
+    
+    if (tcb->next == tcb)
+    {
+        _head = 0;
+    }
+    else
+    {
+        tcb->prev->next = tcb->next;
+        tcb->next->prev = tcb->prev;
+        
+        if (_head == tcb)
+        {
+            _head = tcb->next;
+            _quantumLeft = _quantum;
+        }
+    }
+    
+    tcb->next = tcb->prev = 0;
+}
+
+/* This function ends the current task's turn and starts the next task's. */
+static void Rotate(void)
+{
+    if (_head)
+    {
+        _head = _head->next;
+    }
+    
+    _quantumLeft = _quantum;
+}
+
+/* This function moves tasks whose sleep time has elapsed out of 
+_sleepingTasksQueue and back into the list of ready tasks. */
+static void UpdateSleepingTasks(void)
+{
+    uint32_t ticks = OS_ElapsedTicks();
+    OS_TCB_t* extracted = 0;
+    
+    while (!OS_TCBPriorityQueueEmpty(&_sleepingTasksQueue) && 
+           ticks > OS_TCBPriorityQueuePeek(&_sleepingTasksQueue)->data)
+    {
+        extracted = OS_TCBPriorityQueueExtract(&_sleepingTasksQueue);
+        extracted->data = 0;  // clear any data related to sleeping
+        extracted->state &= ~TASK_STATE_SLEEP;
+        ListAppend(extracted);
+    }
+}
+
+static const OS_TCB_t* SRR_SchedulerCallback(void) 
+{
+    UpdateSleepingTasks();
+    
+    // A task that yields gives up the rest of its quantum.
+    if (_head && _head == OS_CurrentTCB() && (_head->state & TASK_STATE_YIELD))
+    {
+        _head->state &= ~TASK_STATE_YIELD;
+        Rotate();
+    }
+    
+    if (!_head)
+    {
+        // No tasks in the list, so return the idle task
+        return OS_idleTCB_p;
+    }
+    
+    return _head;
+}
+
+static uint32_t SRR_AddTaskCallback(OS_TCB_t * const tcb, const uint32_t priority) 
+{
+    // Every task must fit in the sleeping tasks queue.
+    if (_nTasks == SRR_MAX_TASKS)
+    {
+        return OS_ADD_TASK_ERR_FULL;
+    }
+    
+    _nTasks++;
+    tcb->priority = priority;
+    ListAppend(tcb);
+    return OS_ADD_TASK_OK;
+}
+
+static void SRR_TaskExitCallback(OS_TCB_t * const tcb) 
+{
+    // Remove the given TCB from the list of tasks so it won't be run again
+    ListRemove(tcb);
+    _nTasks--;
+}
+
+static void SRR_WaitCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue,
+                               OS_TCB_t* const tcb)
+{
+    ListRemove(tcb);
+    OS_TCBPriorityQueueInsert(waitingTaskQueue, tcb);
+    
+    // Set the PendSV to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;   
+}
+
+static void SRR_NotifyCallback(OS_tcbPriorityQueue_t* const waitingTaskQueue) 
+{
+    OS_TCB_t* tcb = OS_TCBPriorityQueueExtract(waitingTaskQueue);
+    if (!tcb)
+    {
+        return;
+    }
+    
+    tcb->state &= ~TASK_STATE_WAIT;
+    ListAppend(tcb);
+    
+    // Set the PendSV bit to invoke the scheduler.
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+/* Moves a task from the list into the sleeping tasks queue. This is called in 
+handler mode by the sleep callback, so it cannot yield and sets PendSV instead. */
+static void SleepInHandler(void* const tcb)
+{
+    ListRemove((OS_TCB_t* )tcb);
+    OS_TCBPriorityQueueInsert(&_sleepingTasksQueue, (OS_TCB_t* )tcb);
+    
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+static void SRR_SleepCallback(OS_TCB_t* const tcb, 
+                                const uint32_t currentTime, 
+                                const uint32_t time)
+{
+    // This is called in thread mode, where tasks are unprivileged and cannot
+    // mask interrupts, so the list is changed in handler mode.
+    _OS_Call(SleepInHandler, tcb);
+}
+
+/* Counts down the quantum of the running task and starts the next task's turn
+when it expires. PendSV is set by the system tick handler after this returns. */
+static void SRR_TickCallback(const uint32_t ticks)
+{
+    if (_head && _head == OS_CurrentTCB() && --_quantumLeft == 0)
+    {
+        Rotate();
+    }
+}
@@ -1,10 +1,30 @@
-//#ifndef __simpleRoundRobin_h__
-//#define __simpleRoundRobin_h__
+#ifndef __simpleRoundRobin_h__
+#define __simpleRoundRobin_h__
 
-//#include "os.h"
+#include "os.h"
 
-//#define SRR_MAX_TASKS 8
+/*
+The round-robin scheduler runs every ready task in turn for a fixed quantum of 
+ticks. A task that yields before its quantum has expired gives up the rest of 
+it. All tasks are treated equally; the priority passed to OS_AddTask() is only
+used to order the task in objects' waiting tasks queues.
 
-//extern OS_Scheduler_t const simpleRoundRobinScheduler;
+At most SRR_MAX_TASKS tasks may be added, so that every task can be sleeping at
+once. OS_AddTask() returns OS_ADD_TASK_ERR_FULL for any more.
+*/
 
-//#endif /* __simpleRoundRobin_h__ */
+#define SRR_MAX_TASKS MAX_TASKS
+
+#define SRR_DEFAULT_QUANTUM 10
+
+extern OS_Scheduler_t const simpleRoundRobinScheduler;
+
+/**
+* @brief Initialise the round-robin scheduler. This must be called before 
+*   OS_Start().
+* @param quantum The number of ticks each task may run for before the next 
+*   task is run. If 0, SRR_DEFAULT_QUANTUM is used.
+*/
+void OS_InitSRR(const uint32_t quantum);
+
+#endif /* __simpleRoundRobin_h__ */
@@ -0,0 +1,151 @@
+#include "slab.h"
+
+#include <string.h>
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+static OS_slabClass_t* _classes = 0;
+static uint32_t _nClasses = 0;
+static uint32_t _fallback = SLAB_NO_FALLBACK;
+
+void OS_InitSlab(OS_slabClass_t* const classes, 
+                   const uint32_t nClasses, 
+                   const uint32_t fallback)
+{
+    ASSERT(nClasses > 0 && nClasses <= SLAB_MAX_CLASSES);
+    
+    for (uint32_t i = 0; i < nClasses; i++)
+    {
+        OS_slabClass_t* slabClass = &classes[i];
+        
+        ASSERT(i == 0 || slabClass->blockSz > classes[i - 1].blockSz);
+        
+        // The pools are kept out of the mempool registry, so a full set of 
+        // classes does not use up OS_MAX_MEMPOOLS. OS_FreeSized() finds the 
+        // class of a block itself.
+        memset(&slabClass->stats, 0, sizeof(OS_slabStats_t));
+        OS_InitMempoolLockFree(&slabClass->pool, slabClass->blockSz, slabClass->nBlocks, slabClass->elements);
+    }
+    
+    _classes = classes;
+    _nClasses = nClasses;
+    _fallback = fallback;
+}
+
+/* This function returns the index of the smallest class whose blocks hold the
+given size, or _nClasses if there is none. */
+static uint32_t ClassFor(const size_t bytes)
+{
+    uint32_t i = 0;
+    
+    while (i < _nClasses && _classes[i].blockSz < bytes)
+    {
+        i++;
+    }
+    
+    return i;
+}
+
+/* This function records an allocation from a class. */
+static void RecordAlloc(OS_slabClass_t* const slabClass)
+{
+    _OS_AtomicAdd(&slabClass->stats.inUse, 1);
+    _OS_AtomicAdd(&slabClass->stats.nAllocs, 1);
+    
+    // The count is read back after the add, so another allocation or free in
+    // between may be included, but it is still a count the class reached.
+    uint32_t inUse = slabClass->stats.inUse;
+    uint32_t peak;
+    
+    do
+    {
+        peak = __LDREXW((uint32_t* )&slabClass->stats.peakInUse);
+        if (inUse <= peak)
+        {
+            __CLREX();
+            return;
+        }
+    } while (__STREXW(inUse, (uint32_t* )&slabClass->stats.peakInUse));
+}
+
+/* This function attempts to allocate from the class for a size and, if 
+fallback is enabled, from the larger classes after it. It returns 0 if every 
+class it tried was empty. */
+static void* TryAlloc(const uint32_t first)
+{
+    uint32_t last = (_fallback == SLAB_FALLBACK) ? _nClasses - 1 : first;
+    
+    for (uint32_t i = first; i <= last; i++)
+    {
+        void* block = OS_TryMalloc(&_classes[i].pool);
+        
+        if (block)
+        {
+            if (i != first)
+            {
+                _OS_AtomicAdd(&_classes[first].stats.nFallbacks, 1);
+            }
+            
+            RecordAlloc(&_classes[i]);
+            return block;
+        }
+    }
+    
+    _OS_AtomicAdd(&_classes[first].stats.nExhausted, 1);
+    return 0;
+}
+
+void* OS_TryMallocSized(const size_t bytes)
+{
+    uint32_t first = ClassFor(bytes);
+    
+    return (first < _nClasses) ? TryAlloc(first) : 0;
+}
+
+void* OS_MallocSized(const size_t bytes)
+{
+    uint32_t first = ClassFor(bytes);
+    
+    if (first == _nClasses)
+    {
+        return 0;
+    }
+    
+    void* block = TryAlloc(first);
+    if (!block)
+    {
+        // Every class that could serve the allocation is empty, so wait for a
+        // block of its own class.
+        block = OS_Malloc(&_classes[first].pool);
+        RecordAlloc(&_classes[first]);
+    }
+    
+    return block;
+}
+
+void OS_FreeSized(void* const ptr)
+{
+    for (uint32_t i = 0; i < _nClasses; i++)
+    {
+        OS_slabClass_t* slabClass = &_classes[i];
+        
+        if (OS_MempoolOwns(&slabClass->pool, ptr))
+        {
+            _OS_AtomicAdd(&slabClass->stats.nFrees, 1);
+            _OS_AtomicAdd(&slabClass->stats.inUse, (uint32_t)-1);
+            OS_Dalloc(&slabClass->pool, ptr);
+            return;
+        }
+    }
+    
+    // The block was not allocated by the slab allocator.
+    ASSERT(0);
+}
+
+const OS_slabStats_t* OS_SlabGetStats(const uint32_t index)
+{
+    ASSERT(index < _nClasses);
+    return &_classes[index].stats;
+}
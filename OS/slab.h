@@ -0,0 +1,111 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memory.h"
+
+#define SLAB_MAX_CLASSES  8
+
+#define SLAB_NO_FALLBACK  0
+#define SLAB_FALLBACK     1
+
+/*
+The slab allocator serves allocations of any size from a set of size classes, 
+each of which is a lock-free memory pool of fixed size blocks. An allocation is
+served by the smallest class whose blocks are large enough, so it is as fast as
+OS_TryMalloc() and the pools can never fragment; the cost is the unused part of 
+each block.
+
+If fallback is enabled and the class an allocation belongs to is empty, the 
+allocation is served by the next larger class that is not, rather than waiting.
+*/
+
+/**
+* @brief This structure holds the statistics of a size class.
+*/
+typedef struct s_SlabStats
+{
+    // Allocations served by, and blocks freed back to, the class.
+    volatile uint32_t  nAllocs;
+    volatile uint32_t  nFrees;
+    
+    // The number of blocks currently allocated, and the most there have been.
+    volatile uint32_t  inUse;
+    volatile uint32_t  peakInUse;
+    
+    // Allocations for this class served by a larger class because this one 
+    // was empty, and allocations that found this class and every larger one 
+    // empty.
+    volatile uint32_t  nFallbacks;
+    volatile uint32_t  nExhausted;
+} OS_slabStats_t;
+
+/**
+* @brief This structure describes a single size class. The fields above the 
+*   line are set by the application, the rest by OS_InitSlab().
+*/
+typedef struct s_SlabClass
+{
+    // The size of each block, which must be a multiple of 4, the number of 
+    // blocks, and a statically allocated array of nBlocks blocks.
+    size_t   blockSz;
+    size_t   nBlocks;
+    void**   elements;
+    
+    /* ------------------------------------------------------------------- */
+    
+    OS_slabStats_t  stats;
+    OS_mempool_t    pool;
+} OS_slabClass_t;
+
+/**
+* @brief Initialise the slab allocator with a set of size classes. This must be
+*   called once, before any allocation is made.
+* @param classes The array of classes, in increasing order of block size. It 
+*   must remain valid for as long as the allocator is used.
+* @param nClasses The number of classes, from 1 to SLAB_MAX_CLASSES.
+* @param fallback SLAB_FALLBACK to serve an allocation from a larger class when
+*   its own class is empty, or SLAB_NO_FALLBACK to always use its own class.
+*/
+void OS_InitSlab(OS_slabClass_t* const classes, 
+                   const uint32_t nClasses, 
+                   const uint32_t fallback);
+
+/**
+* @brief Allocate a block of at least the given size. If no block is free, the
+*   calling task waits until a block of the class the size belongs to is freed.
+*   This must only be called by a task.
+* @param bytes The size required.
+* @return Pointer to the block.
+* @return 0 if the size is larger than the largest class.
+*/
+void* OS_MallocSized(const size_t bytes);
+
+/**
+* @brief Allocate a block of at least the given size if one is free, without 
+*   waiting. This may be called from an interrupt handler.
+* @param bytes The size required.
+* @return Pointer to the block.
+* @return 0 if no block is free, or the size is larger than the largest class.
+*/
+void* OS_TryMallocSized(const size_t bytes);
+
+/**
+* @brief Free a block allocated with OS_MallocSized() or OS_TryMallocSized(). 
+*   This may be called from an interrupt handler. Slab blocks must be freed 
+*   with this function: the class pools are not registered with 
+*   OS_MempoolRegister(), so OS_MempoolFind() and OS_ITCFreeBlock() do not 
+*   know them.
+* @param ptr Pointer to the block.
+*/
+void OS_FreeSized(void* const ptr);
+
+/**
+* @brief Returns the statistics of a size class.
+* @param index The index of the class in the array given to OS_InitSlab().
+*/
+const OS_slabStats_t* OS_SlabGetStats(const uint32_t index);
+
+#endif  // SLAB_H
@@ -0,0 +1,145 @@
+#include "spsc_channel.h"
+
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+/*
+Waking relies on the order of three steps on each side. A side that is about to
+wait takes the check code, sets its waiting flag and only then checks the ring 
+again. The other side updates its index and only then checks the waiting flag. 
+So either the waiting side sees the update, or the other side sees the flag and
+notifies, which changes the check code and causes the wait to be aborted if it
+has not yet happened.
+*/
+
+void OS_InitSPSCChannel(OS_spscChannel_t* const channel, 
+                          void** const buf, 
+                          const uint32_t capacity)
+{
+    ASSERT(capacity && (capacity & (capacity - 1)) == 0);
+    
+    channel->buf = buf;
+    channel->capacity = capacity;
+    channel->mask = capacity - 1;
+    channel->head = 0;
+    channel->tail = 0;
+    channel->highWater = capacity;
+    channel->lowWater = capacity - 1;
+    channel->consumerWaiting = 0;
+    channel->producerWaiting = 0;
+    
+    OS_InitTCBPriorityQueue(&channel->_consumerQueue, channel->_consumer, 1, TCBPQ_ORDER_BY_PRIORITY);
+    OS_InitTCBPriorityQueue(&channel->_producerQueue, channel->_producer, 1, TCBPQ_ORDER_BY_PRIORITY);
+}
+
+void OS_SPSCSetWatermarks(OS_spscChannel_t* const channel, 
+                            const uint32_t highWater, 
+                            const uint32_t lowWater)
+{
+    ASSERT(highWater > 0 && highWater <= channel->capacity && lowWater < highWater);
+    
+    channel->highWater = highWater;
+    channel->lowWater = lowWater;
+}
+
+uint32_t OS_SPSCTrySend(OS_spscChannel_t* const channel, void* const item)
+{
+    uint32_t tail = channel->tail;
+    
+    if (tail - channel->head >= channel->capacity)
+    {
+        return 0;
+    }
+    
+    channel->buf[tail & channel->mask] = item;
+    
+    // The item must be in the buffer before the consumer can see the new tail.
+    __DMB();
+    _OS_AtomicAdd(&channel->tail, 1);
+    
+    _OS_WakeIfWaiting(&channel->consumerWaiting, &channel->_consumerQueue);
+    return 1;
+}
+
+void OS_SPSCSend(OS_spscChannel_t* const channel, void* const item)
+{
+    if (channel->tail - channel->head >= channel->highWater)
+    {
+        // Wait until the consumer has brought the channel down to the low 
+        // watermark.
+        while (channel->tail - channel->head > channel->lowWater)
+        {
+            uint32_t checkCode = OS_GetCheckCode();
+            
+            channel->producerWaiting = 1;
+            __DMB();
+            
+            if (channel->tail - channel->head <= channel->lowWater)
+            {
+                // Space was made before the flag was seen.
+                channel->producerWaiting = 0;
+                break;
+            }
+            
+            OS_Wait(&channel->_producerQueue, checkCode);
+        }
+    }
+    
+    // There is only one producer, so there is still space for the item.
+    OS_SPSCTrySend(channel, item);
+}
+
+uint32_t OS_SPSCTryReceive(OS_spscChannel_t* const channel, void** const item)
+{
+    uint32_t head = channel->head;
+    
+    if (head == channel->tail)
+    {
+        return 0;
+    }
+    
+    // The item must be read before the producer can see the new head and 
+    // overwrite it.
+    __DMB();
+    *item = channel->buf[head & channel->mask];
+    __DMB();
+    _OS_AtomicAdd(&channel->head, 1);
+    __DMB();
+    
+    if (channel->tail - channel->head <= channel->lowWater)
+    {
+        _OS_WakeIfWaiting(&channel->producerWaiting, &channel->_producerQueue);
+    }
+    return 1;
+}
+
+void* OS_SPSCReceive(OS_spscChannel_t* const channel)
+{
+    void* item;
+    
+    while (!OS_SPSCTryReceive(channel, &item))
+    {
+        uint32_t checkCode = OS_GetCheckCode();
+        
+        channel->consumerWaiting = 1;
+        __DMB();
+        
+        if (channel->head != channel->tail)
+        {
+            // An item was sent before the flag was seen.
+            channel->consumerWaiting = 0;
+            continue;
+        }
+        
+        OS_Wait(&channel->_consumerQueue, checkCode);
+    }
+    
+    return item;
+}
+
+uint32_t OS_SPSCGetCount(OS_spscChannel_t* const channel)
+{
+    return channel->tail - channel->head;
+}
@@ -0,0 +1,137 @@
+#ifndef SPSC_CHANNEL_H
+#define SPSC_CHANNEL_H
+
+#include <stdint.h>
+
+#include "task.h"
+#include "tcb_priority_queue.h"
+
+/*
+A single-producer, single-consumer (SPSC) channel passes word-sized items, 
+usually pointers, from exactly one producer to exactly one consumer in FIFO 
+order. The producer may be a task or an interrupt handler, as may the consumer.
+
+The channel is a ring buffer whose capacity is a power of two. The producer 
+only ever writes the tail index and the consumer only ever writes the head 
+index, so neither side takes a lock and, whilst the ring is neither empty nor 
+full, no SVC calls are made. The kernel is only entered when the consumer must 
+wait for an item or the producer must wait for space, and by the other side to 
+wake it, which it does only if the waiting flag has been set.
+
+An interrupt handler cannot wake the waiting side directly, so the wake is 
+deferred to PendSV, sharing the OS_MAX_ISR_NOTIFIES slots of 
+OS_NotifyFromISR(). If every slot is in use, the waiting flag is left set and 
+the wake is only retried by the next send or receive on the channel; nothing 
+retries it from the tick. An interrupt handler that may be the last to touch a
+channel for some time should not share it with handlers that can fill the 
+slots.
+*/
+
+/**
+* @brief This structure contains a single SPSC channel. It must be initialised
+*   with OS_InitSPSCChannel() before use.
+*/
+typedef struct s_SPSCChannel
+{
+    // The ring buffer, of capacity items, and capacity - 1 to mask the indices.
+    void**    buf;
+    uint32_t  capacity;
+    uint32_t  mask;
+    
+    // The head is the index of the next item to be received and the tail is 
+    // the index of the next item to be sent. They run freely and are masked
+    // when used, so the number of items in the channel is tail - head.
+    volatile uint32_t  head;
+    volatile uint32_t  tail;
+    
+    // A blocking send waits once the channel holds highWater items, and is 
+    // woken once the consumer has brought it down to lowWater items. By 
+    // default they are capacity and capacity - 1, so a send only waits while 
+    // the channel is full. See OS_SPSCSetWatermarks().
+    uint32_t  highWater;
+    uint32_t  lowWater;
+    
+    // Set by a side before it waits, and cleared by the other side when it 
+    // wakes it.
+    volatile uint32_t  consumerWaiting;
+    volatile uint32_t  producerWaiting;
+    
+    // The queues the consumer and producer wait in. As there is only one of
+    // each, each can hold a single task.
+    OS_tcbPriorityQueue_t  _consumerQueue;
+    OS_TCB_t*              _consumer[1];
+    OS_tcbPriorityQueue_t  _producerQueue;
+    OS_TCB_t*              _producer[1];
+} OS_spscChannel_t;
+
+/**
+* @brief Initialise an SPSC channel. This must be called before the channel is
+*   used.
+* @param channel Pointer to the channel to initialise.
+* @param buf Pointer to a statically allocated array of capacity items.
+* @param capacity The number of items the channel can hold. This must be a 
+*   power of two.
+*/
+void OS_InitSPSCChannel(OS_spscChannel_t* const channel, 
+                          void** const buf, 
+                          const uint32_t capacity);
+
+/**
+* @brief Set the watermarks of a channel, to apply backpressure to a producer 
+*   before the channel is full. Once the channel holds highWater items, 
+*   OS_SPSCSend() waits until the consumer has brought it down to lowWater 
+*   items, so the producer runs in bursts rather than once per item received.
+*   OS_SPSCTrySend() ignores the watermarks and fills the channel.
+* @param channel Pointer to the channel.
+* @param highWater The number of items at which a send waits, from 1 to the 
+*   channel's capacity.
+* @param lowWater The number of items at which a waiting send is woken, less 
+*   than highWater.
+*/
+void OS_SPSCSetWatermarks(OS_spscChannel_t* const channel, 
+                            const uint32_t highWater, 
+                            const uint32_t lowWater);
+
+/**
+* @brief Send an item if there is space for it, without waiting. This may be 
+*   called from an interrupt handler.
+* @param channel Pointer to the channel to send to.
+* @param item The item to send.
+* @return 1 if the item was sent.
+* @return 0 if the channel is full.
+*/
+uint32_t OS_SPSCTrySend(OS_spscChannel_t* const channel, void* const item);
+
+/**
+* @brief Send an item, waiting for space if the channel has reached its high 
+*   watermark, which by default is when it is full. This must only be called 
+*   by a task.
+* @param channel Pointer to the channel to send to.
+* @param item The item to send.
+*/
+void OS_SPSCSend(OS_spscChannel_t* const channel, void* const item);
+
+/**
+* @brief Receive an item if there is one, without waiting. This may be called 
+*   from an interrupt handler.
+* @param channel Pointer to the channel to receive from.
+* @param item Pointer to the location the received item will be written to.
+* @return 1 if an item was received.
+* @return 0 if the channel is empty.
+*/
+uint32_t OS_SPSCTryReceive(OS_spscChannel_t* const channel, void** const item);
+
+/**
+* @brief Receive an item, waiting for one if the channel is empty. This must 
+*   only be called by a task.
+* @param channel Pointer to the channel to receive from.
+* @return The received item.
+*/
+void* OS_SPSCReceive(OS_spscChannel_t* const channel);
+
+/**
+* @brief Returns the number of items currently in the channel.
+*/
+uint32_t OS_SPSCGetCount(OS_spscChannel_t* const channel);
+
+#endif  // SPSC_CHANNEL_H
@@ -0,0 +1,191 @@
+#include "stream_buffer.h"
+
+#include <string.h>
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+/*
+Waiting and waking follow the same order of steps as the SPSC channel, see 
+spsc_channel.c. The only difference is that the writer wakes the reader only 
+once the trigger level has been reached.
+*/
+
+void OS_InitStreamBuffer(OS_streamBuffer_t* const stream,
+                           uint8_t* const buf,
+                           const uint32_t size,
+                           const uint32_t triggerLevel)
+{
+    ASSERT(size && (size & (size - 1)) == 0);
+    
+    stream->buf = buf;
+    stream->size = size;
+    stream->mask = size - 1;
+    stream->head = 0;
+    stream->tail = 0;
+    stream->readerWaiting = 0;
+    stream->writerWaiting = 0;
+    OS_StreamBufferSetTriggerLevel(stream, triggerLevel);
+    stream->wakeLevel = triggerLevel;
+    
+    OS_InitTCBPriorityQueue(&stream->_readerQueue, stream->_reader, 1, TCBPQ_ORDER_BY_PRIORITY);
+    OS_InitTCBPriorityQueue(&stream->_writerQueue, stream->_writer, 1, TCBPQ_ORDER_BY_PRIORITY);
+}
+
+void OS_StreamBufferSetTriggerLevel(OS_streamBuffer_t* const stream, 
+                                      const uint32_t triggerLevel)
+{
+    ASSERT(triggerLevel > 0 && triggerLevel <= stream->size);
+    stream->triggerLevel = triggerLevel;
+}
+
+size_t OS_StreamBufferTryWrite(OS_streamBuffer_t* const stream, 
+                                 const void* const data, 
+                                 const size_t len)
+{
+    uint32_t tail = stream->tail;
+    uint32_t space = stream->size - (tail - stream->head);
+    uint32_t n = (len < space) ? len : space;
+    
+    if (n == 0)
+    {
+        return 0;
+    }
+    
+    // Copy in at most two parts, as the bytes may wrap around the end of the 
+    // buffer.
+    uint32_t offset = tail & stream->mask;
+    uint32_t first = stream->size - offset;
+    
+    if (first > n)
+    {
+        first = n;
+    }
+    
+    memcpy(&stream->buf[offset], data, first);
+    memcpy(&stream->buf[0], (const uint8_t* )data + first, n - first);
+    
+    // The bytes must be in the buffer before the reader can see the new tail.
+    __DMB();
+    _OS_AtomicAdd(&stream->tail, n);
+    __DMB();
+    
+    if (stream->tail - stream->head >= stream->wakeLevel)
+    {
+        _OS_WakeIfWaiting(&stream->readerWaiting, &stream->_readerQueue);
+    }
+    
+    return n;
+}
+
+void OS_StreamBufferWrite(OS_streamBuffer_t* const stream, 
+                            const void* const data, 
+                            const size_t len)
+{
+    size_t written = 0;
+    
+    while (1)
+    {
+        written += OS_StreamBufferTryWrite(stream, (const uint8_t* )data + written, len - written);
+        if (written == len)
+        {
+            return;
+        }
+        
+        // The buffer is full, so wait for the reader to make space.
+        uint32_t checkCode = OS_GetCheckCode();
+        
+        stream->writerWaiting = 1;
+        __DMB();
+        
+        if (stream->tail - stream->head < stream->size)
+        {
+            stream->writerWaiting = 0;
+            continue;
+        }
+        
+        OS_Wait(&stream->_writerQueue, checkCode);
+    }
+}
+
+size_t OS_StreamBufferTryRead(OS_streamBuffer_t* const stream, 
+                                void* const data, 
+                                const size_t maxLen)
+{
+    uint32_t head = stream->head;
+    uint32_t count = stream->tail - head;
+    uint32_t n = (maxLen < count) ? maxLen : count;
+    
+    if (n == 0)
+    {
+        return 0;
+    }
+    
+    // The bytes must be read before the writer can see the new head and 
+    // overwrite them.
+    __DMB();
+    
+    uint32_t offset = head & stream->mask;
+    uint32_t first = stream->size - offset;
+    
+    if (first > n)
+    {
+        first = n;
+    }
+    
+    memcpy(data, &stream->buf[offset], first);
+    memcpy((uint8_t* )data + first, &stream->buf[0], n - first);
+    
+    __DMB();
+    _OS_AtomicAdd(&stream->head, n);
+    __DMB();
+    
+    _OS_WakeIfWaiting(&stream->writerWaiting, &stream->_writerQueue);
+    
+    return n;
+}
+
+size_t OS_StreamBufferRead(OS_streamBuffer_t* const stream, 
+                             void* const data, 
+                             const size_t maxLen)
+{
+    if (maxLen == 0)
+    {
+        return 0;
+    }
+    
+    while (1)
+    {
+        uint32_t level = stream->triggerLevel;
+        
+        if (level > maxLen)
+        {
+            level = maxLen;
+        }
+        
+        if (stream->tail - stream->head >= level)
+        {
+            return OS_StreamBufferTryRead(stream, data, maxLen);
+        }
+        
+        uint32_t checkCode = OS_GetCheckCode();
+        
+        stream->wakeLevel = level;
+        stream->readerWaiting = 1;
+        __DMB();
+        
+        if (stream->tail - stream->head >= level)
+        {
+            stream->readerWaiting = 0;
+            continue;
+        }
+        
+        OS_Wait(&stream->_readerQueue, checkCode);
+    }
+}
+
+uint32_t OS_StreamBufferGetCount(OS_streamBuffer_t* const stream)
+{
+    return stream->tail - stream->head;
+}
@@ -0,0 +1,141 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "task.h"
+#include "tcb_priority_queue.h"
+
+/*
+A stream buffer moves a stream of bytes of any length from one writer to one 
+reader through a ring buffer, without message boundaries. The writer may be a 
+task or an interrupt handler, for example a UART or ADC handler.
+
+The reader only waits until the trigger level is reached, i.e. until at least 
+that many bytes are in the buffer, so a reader that wants data in chunks is 
+woken once per chunk rather than once per byte. Like the SPSC channel, the 
+writer only writes the tail index and the reader only writes the head index, so
+no lock is needed and the kernel is only entered to wait or to wake. 
+
+An interrupt handler cannot wake the waiting side directly, so the wake is 
+deferred to PendSV, sharing the OS_MAX_ISR_NOTIFIES slots of 
+OS_NotifyFromISR(). If every slot is in use, the waiting flag is left set and 
+the wake is only retried by the next write or read on the buffer; nothing 
+retries it from the tick. A writer in an interrupt handler that may stop 
+writing for some time should not share the slots with handlers that can fill 
+them.
+*/
+
+/**
+* @brief This structure contains a single stream buffer. It must be initialised
+*   with OS_InitStreamBuffer() before use.
+*/
+typedef struct s_StreamBuffer
+{
+    // The ring buffer, of size bytes, and size - 1 to mask the indices.
+    uint8_t*  buf;
+    uint32_t  size;
+    uint32_t  mask;
+    
+    // The number of bytes that must be in the buffer before a waiting reader 
+    // is woken.
+    volatile uint32_t  triggerLevel;
+    
+    // The number of bytes the waiting reader is waiting for, which is the 
+    // trigger level unless the reader asked for fewer bytes.
+    volatile uint32_t  wakeLevel;
+    
+    // Free running indices of the next byte to read and to write, so the 
+    // number of bytes in the buffer is tail - head.
+    volatile uint32_t  head;
+    volatile uint32_t  tail;
+    
+    // Set by a side before it waits, and cleared by the other side when it 
+    // wakes it.
+    volatile uint32_t  readerWaiting;
+    volatile uint32_t  writerWaiting;
+    
+    OS_tcbPriorityQueue_t  _readerQueue;
+    OS_TCB_t*              _reader[1];
+    OS_tcbPriorityQueue_t  _writerQueue;
+    OS_TCB_t*              _writer[1];
+} OS_streamBuffer_t;
+
+/**
+* @brief Initialise a stream buffer. This must be called before the buffer is 
+*   used.
+* @param stream Pointer to the stream buffer to initialise.
+* @param buf Pointer to a statically allocated array of size bytes.
+* @param size The size of the buffer in bytes. This must be a power of two.
+* @param triggerLevel The number of bytes needed to wake a waiting reader, from 
+*   1 to size.
+*/
+void OS_InitStreamBuffer(OS_streamBuffer_t* const stream,
+                           uint8_t* const buf,
+                           const uint32_t size,
+                           const uint32_t triggerLevel);
+
+/**
+* @brief Change the trigger level of a stream buffer. The new level applies the
+*   next time the reader waits.
+* @param stream Pointer to the stream buffer.
+* @param triggerLevel The new trigger level, from 1 to the size of the buffer.
+*/
+void OS_StreamBufferSetTriggerLevel(OS_streamBuffer_t* const stream, 
+                                      const uint32_t triggerLevel);
+
+/**
+* @brief Write as many bytes as there is space for, without waiting. This may 
+*   be called from an interrupt handler.
+* @param stream Pointer to the stream buffer to write to.
+* @param data Pointer to the bytes to write.
+* @param len The number of bytes to write.
+* @return The number of bytes written, which may be less than len.
+*/
+size_t OS_StreamBufferTryWrite(OS_streamBuffer_t* const stream, 
+                                 const void* const data, 
+                                 const size_t len);
+
+/**
+* @brief Write bytes, waiting for space whenever the buffer is full until all 
+*   of them have been written. This must only be called by a task.
+* @param stream Pointer to the stream buffer to write to.
+* @param data Pointer to the bytes to write.
+* @param len The number of bytes to write.
+*/
+void OS_StreamBufferWrite(OS_streamBuffer_t* const stream, 
+                            const void* const data, 
+                            const size_t len);
+
+/**
+* @brief Read up to maxLen bytes that are already in the buffer, without 
+*   waiting. This may be called from an interrupt handler.
+* @param stream Pointer to the stream buffer to read from.
+* @param data Pointer to where the bytes will be copied.
+* @param maxLen The maximum number of bytes to read.
+* @return The number of bytes read, which may be 0.
+*/
+size_t OS_StreamBufferTryRead(OS_streamBuffer_t* const stream, 
+                                void* const data, 
+                                const size_t maxLen);
+
+/**
+* @brief Read up to maxLen bytes, first waiting until the trigger level, or 
+*   maxLen if it is smaller, has been reached. This must only be called by a 
+*   task.
+* @param stream Pointer to the stream buffer to read from.
+* @param data Pointer to where the bytes will be copied.
+* @param maxLen The maximum number of bytes to read.
+* @return The number of bytes read.
+*/
+size_t OS_StreamBufferRead(OS_streamBuffer_t* const stream, 
+                             void* const data, 
+                             const size_t maxLen);
+
+/**
+* @brief Returns the number of bytes currently in the stream buffer.
+*/
+uint32_t OS_StreamBufferGetCount(OS_streamBuffer_t* const stream);
+
+#endif  // STREAM_BUFFER_H
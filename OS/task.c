@@ -21,4 +21,14 @@ uint32_t IsTaskSleeping(OS_TCB_t* const task, const uint32_t elapsedTicks)
     } 
     
     return asleep;
-}
\ No newline at end of file
+}
+
+void OS_SetTaskTiming(OS_TCB_t* const task, 
+                        const uint32_t wcet, 
+                        const uint32_t period,
+                        const uint32_t deadline)
+{
+    task->timing.wcet = wcet;
+    task->timing.period = period;
+    task->timing.deadline = deadline ? deadline : period;
+}
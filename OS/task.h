@@ -13,6 +13,8 @@
 
 #define MAX_TASKS 10
 
+struct s_TCBPriorityQueue;
+
 /** 
 * @brief Describes a single stack frame, as found at the top of the stack of a 
 *   task that is not currently running.  Registers r0-r3, r12, lr, pc and psr 
@@ -38,10 +40,61 @@ typedef struct s_StackFrame {
 	volatile uint32_t psr;
 } OS_StackFrame_t;
 
+/**
+* @brief Struct containing the timing parameters a task may declare, in ticks.
+*   These are used by the scheduler for admission control. A task with a period
+*   of 0 has not declared its timing and is not included in the analysis.
+*/
+typedef struct s_TaskTiming
+{
+    // The worst-case execution time of one job of the task.
+    uint32_t wcet;
+    
+    // The minimum time between two consecutive releases of the task.
+    uint32_t period;
+    
+    // The time after its release by which a job of the task must complete. 
+    // This must not be greater than the period.
+    uint32_t deadline;
+} OS_taskTiming_t;
+
+/**
+* @brief Struct containing the deadline statistics of a task, in ticks. These 
+*   are only kept for tasks that have declared their timing, and are updated
+*   on each context switch and each call to OS_WaitNextPeriod(). Each release 
+*   of the task is a 'job'.
+*/
+typedef struct s_TaskStats
+{
+    // The release time and absolute deadline of the current job.
+    uint32_t volatile release;
+    uint32_t volatile absDeadline;
+    
+    // Set to 1 once the current job has first been switched in, and once it 
+    // has been counted as having missed its deadline, respectively.
+    uint32_t volatile started;
+    uint32_t volatile missed;
+    
+    // The number of completed jobs, and the number of jobs that have missed 
+    // their deadline.
+    uint32_t volatile nJobs;
+    uint32_t volatile nMisses;
+    
+    // The worst observed response time, i.e. the time from release to 
+    // completion, and the worst observed release jitter, i.e. the time from 
+    // release until the job first started executing.
+    uint32_t volatile worstResponse;
+    uint32_t volatile worstJitter;
+    
+    // How late the most recent job to miss its deadline was when the miss was
+    // detected, in ticks.
+    uint32_t volatile lateness;
+} OS_taskStats_t;
+
 /** 
 * @brief Struct containing a task control block, which is a 'task'.
 */
-typedef struct {
+typedef struct s_TCB {
 	// Task stack pointer. It's important that this is the first entry in the
     // structure, so that a simple double-dereference of a TCB pointer yields a 
     // stack pointer. 
@@ -57,12 +110,43 @@ typedef struct {
 	uint32_t volatile priority;
     
 	uint32_t volatile data;
+    
+    // These fields store the priority queue the task is currently held in, and
+    // its index in that queue's store array. They are maintained by 
+    // tcb_priority_queue.c, and allow a task to be found in, or re-keyed 
+    // within, its queue without searching it. If the task is not in a queue,
+    // queue will be equal to 0.
+    struct s_TCBPriorityQueue* volatile queue;
+    uint32_t volatile queueIndex;
+    
+    // The timing parameters the task has declared, if any. See 
+    // OS_SetTaskTiming().
+    OS_taskTiming_t timing;
+    
+    // The deadline statistics of the task. These are only kept if the task 
+    // has declared its timing.
+    OS_taskStats_t stats;
+    
+    // The index of the scheduling class the task belongs to. See 
+    // OS_SetSchedulingClass() in os.h.
+    uint32_t schedClass;
+    
+    // The partition the task belongs to, if the partition scheduler is in use.
+    // See partitionScheduler.h.
+    uint32_t partition;
+    
+    // Links to the next and previous tasks, for schedulers that keep their
+    // ready tasks in a list rather than a priority queue. See 
+    // simpleRoundRobin.c.
+    struct s_TCB* next;
+    struct s_TCB* prev;
 } OS_TCB_t;
 
 /* Constants that define bits in a thread's 'state' field. */
 #define TASK_STATE_YIELD   (1UL << 0)  
 #define TASK_STATE_SLEEP   (1UL << 1)  
 #define TASK_STATE_WAIT    (1UL << 2)  
+#define TASK_STATE_EXIT    (1UL << 3)  
 
 /**
 * @brief Determine whether a task is in the wait state.
@@ -82,4 +166,19 @@ uint32_t IsTaskWaiting(const uint32_t taskState);
 */
 uint32_t IsTaskSleeping(OS_TCB_t* const task, const uint32_t elapsedTicks);
 
+/**
+* @brief Declare the timing parameters of a task so that it is included in the
+*   scheduler's admission control. This must be called after OS_InitialiseTCB() 
+*   and before the task is added with OS_AddTask().
+* @param task The task in question.
+* @param wcet The worst-case execution time of one job of the task, in ticks.
+* @param period The minimum time between releases of the task, in ticks.
+* @param deadline The relative deadline of the task, in ticks. If 0, the 
+*   deadline is taken to be equal to the period.
+*/
+void OS_SetTaskTiming(OS_TCB_t* const task, 
+                        const uint32_t wcet, 
+                        const uint32_t period,
+                        const uint32_t deadline);
+
 #endif /* _TASK_H_ */
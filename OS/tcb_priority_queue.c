@@ -24,25 +24,46 @@ static uint32_t ElementValue(const OS_tcbPriorityQueue_t* const queue,
         return queue->store[index]->priority;
 }
 
-/* This function re-orders the heap from the index up. */
+/* This function places a tcb at an index in the heap's store array, and records
+that index in the tcb so it can later be found without searching the heap. */
+static void Place(OS_tcbPriorityQueue_t* const queue, 
+                    const uint32_t index, 
+                    OS_TCB_t* const tcb)
+{
+    queue->store[index] = tcb;
+    tcb->queue = queue;
+    tcb->queueIndex = index;
+}
+
+/* This function swaps the tcbs at two indexes in the heap's store array. */
+static void Swap(OS_tcbPriorityQueue_t* const queue, 
+                   const uint32_t indexA, 
+                   const uint32_t indexB)
+{
+    OS_TCB_t* temp = queue->store[indexA];
+    Place(queue, indexA, queue->store[indexB]);
+    Place(queue, indexB, temp);
+}
+
+/* This function re-orders the heap from the index up. Note, the store array is
+zero-based, so the parent of a node at index i is at index (i - 1) / 2. */
 static void HeapUp(OS_tcbPriorityQueue_t* const queue, const uint32_t index) {
-	if (queue->length == 0) 
-		return;							// heap is empty so stop
-	else if (queue->length - 1 == 0)
-		return;							// node is the root element so stop
+	if (queue->length <= 1) 
+		return;							// heap is empty or has one node so stop
 	
-	int parentIndex = index / 2; 
-	int childIndex  = index;
-    OS_TCB_t* temp;
+	uint32_t childIndex = index;
+    uint32_t parentIndex;
     
-    while (ElementValue(queue, childIndex) < ElementValue(queue, parentIndex))
+    while (childIndex > 0)
     {
-        temp = queue->store[parentIndex];
-        queue->store[parentIndex] = queue->store[childIndex];
-        queue->store[childIndex] = temp;
+        parentIndex = (childIndex - 1) / 2;
+        if (ElementValue(queue, childIndex) >= ElementValue(queue, parentIndex))
+        {
+            break;
+        }
         
-        parentIndex /= 2;
-        childIndex /= 2;
+        Swap(queue, parentIndex, childIndex);
+        childIndex = parentIndex;
     }
 }
 
@@ -54,7 +75,6 @@ static void HeapDown(OS_tcbPriorityQueue_t* const queue, const uint32_t parentNo
 	int32_t    leftIndex   = 2 * parentIndex + 1;
 	int32_t    rightIndex  = 2 * parentIndex + 1 + 1;
 	uint32_t   minIndex    = parentIndex;
-	OS_TCB_t*  temp;
     
     uint_fast8_t sorting = 1;
     while (sorting)
@@ -73,9 +93,7 @@ static void HeapDown(OS_tcbPriorityQueue_t* const queue, const uint32_t parentNo
         
         if (minIndex != parentIndex)
         {
-            temp = queue->store[minIndex];
-            queue->store[minIndex] = queue->store[parentIndex];
-            queue->store[parentIndex] = temp;
+            Swap(queue, minIndex, parentIndex);
             
             parentIndex = minIndex;
             leftIndex = 2 * parentIndex + 1;
@@ -89,20 +107,22 @@ static void HeapDown(OS_tcbPriorityQueue_t* const queue, const uint32_t parentNo
 }
 
 /* This function returns the index at which the tcb passed as a parameter is 
-found in the queue's store array. If the tcb is not found, -1 is returned. */
+found in the queue's store array. If the tcb is not found, -1 is returned. Each
+tcb records the queue it is in and its index, so no search is needed. */
 static int32_t Search(const OS_tcbPriorityQueue_t* const queue, 
                         const OS_TCB_t* const tcb)
 {
-    // Perform breadth-first search to find the tcb.
-    for (uint32_t i = 0; i < queue->length; i++) 
-    {   
-        if (queue->store[i] == tcb)
-        {
-            return i;
-        }
-    }    
+    if (tcb->queue != queue || tcb->queueIndex >= queue->length)
+    {
+        return -1;
+    }
     
-    return -1;
+    if (queue->store[tcb->queueIndex] != tcb)
+    {
+        return -1;
+    }
+    
+    return tcb->queueIndex;
 }
 
 void OS_InitTCBPriorityQueue(OS_tcbPriorityQueue_t* const queue, 
@@ -121,16 +141,17 @@ void OS_InitTCBPriorityQueue(OS_tcbPriorityQueue_t* const queue,
     queue->nMaxTasks = nMaxTasks - 1;
 }
 
-void OS_TCBPriorityQueueInsert(OS_tcbPriorityQueue_t* queue, OS_TCB_t* tcb)
+uint32_t OS_TCBPriorityQueueInsert(OS_tcbPriorityQueue_t* queue, OS_TCB_t* tcb)
 {
     if (OS_TCBPriorityQueueFull(queue))
     {
-        return;
+        return 0;
     }
     
     // The new element is always added to the end of a heap.
-	queue->store[(queue->length)++] = tcb;
+	Place(queue, (queue->length)++, tcb);
 	HeapUp(queue, queue->length - 1);
+    return 1;
 }
 
 OS_TCB_t* OS_TCBPriorityQueueExtract(OS_tcbPriorityQueue_t* const queue)
@@ -143,9 +164,11 @@ OS_TCB_t* OS_TCBPriorityQueueExtract(OS_tcbPriorityQueue_t* const queue)
     // The root value is extracted, and the space filled by the value from the 
     // end.
 	OS_TCB_t* value = queue->store[0];
-	queue->store[0] = queue->store[--(queue->length)];
+    Place(queue, 0, queue->store[--(queue->length)]);
     queue->store[queue->length] = 0;   
 	HeapDown(queue, 0);
+    
+    value->queue = 0;
 	return value;
 }
 
@@ -169,9 +192,36 @@ void OS_TCBPriorityQueueRemove(OS_tcbPriorityQueue_t* const queue,
     {
         return;
     }
-    queue->store[tcbIndex] = queue->store[--(queue->length)];
+    OS_TCB_t* last = queue->store[--(queue->length)];
     queue->store[queue->length] = 0;
-    HeapDown(queue, tcbIndex);
+    ((OS_TCB_t* )tcb)->queue = 0;
+    
+    if (tcbIndex == queue->length)
+    {
+        // The removed task was the last element, so nothing needs re-sorting.
+        return;
+    }
+    
+    // The last element fills the gap. It may belong above or below it, so the
+    // heap is repaired in both directions.
+    Place(queue, tcbIndex, last);
+    HeapUp(queue, tcbIndex);
+    HeapDown(queue, last->queueIndex);
+}
+
+void OS_TCBPriorityQueueUpdate(OS_tcbPriorityQueue_t* const queue,
+                                 const OS_TCB_t* const tcb)
+{
+    int32_t tcbIndex = Search(queue, tcb);
+    if (tcbIndex == -1)
+    {
+        return;
+    }
+    
+    // The task's key has changed in place, so it can only need to move towards
+    // the root or towards the leaves, never both.
+    HeapUp(queue, tcbIndex);
+    HeapDown(queue, tcb->queueIndex);
 }
 
 void OS_TCB_PriorityQueueReSort(OS_tcbPriorityQueue_t* const queue)
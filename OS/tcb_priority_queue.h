@@ -55,9 +55,11 @@ void OS_InitTCBPriorityQueue(OS_tcbPriorityQueue_t* const queue,
 * @brief Insert a tcb ino the priority queue. It will automatically get sorted.
 * @param queue Pointer to the priority queue to insert a tcb into.
 * @param tcb Pointer to the tcb to insert into the priority queue.
+* @return 1 if the tcb was inserted.
+* @return 0 if the queue is full, in which case the tcb is not inserted.
 */
-void OS_TCBPriorityQueueInsert(OS_tcbPriorityQueue_t* const queue, 
-                                 OS_TCB_t* const tcb);
+uint32_t OS_TCBPriorityQueueInsert(OS_tcbPriorityQueue_t* const queue, 
+                                     OS_TCB_t* const tcb);
 
 /**
 * @brief This function allows the caller to simultaneously retrieve the task at
@@ -89,6 +91,18 @@ OS_TCB_t* OS_TCBPriorityQueuePeek(OS_tcbPriorityQueue_t* const queue);
 void OS_TCBPriorityQueueRemove(OS_tcbPriorityQueue_t* const queue, 
                                  const OS_TCB_t* const tcb); 
 
+/**
+* @brief This function restores the order of the queue after the key of a 
+*   single task in it, i.e. its priority or data field, has been changed. Only
+*   the path between the task and the root or leaves is re-sorted, so this is 
+*   O(log n) wherever the task is in the queue. If the task is not in the queue,
+*   no changes to the queue will be made.
+* @param queue The queue the task is held in.
+* @param tcb The task whose key has changed.
+*/
+void OS_TCBPriorityQueueUpdate(OS_tcbPriorityQueue_t* const queue,
+                                 const OS_TCB_t* const tcb);
+
 /**
 * @brief This function re-sorts the queue if, for any reason, the queue is 
 *   believed to be out of order.
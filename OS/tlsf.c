@@ -0,0 +1,363 @@
+#include "tlsf.h"
+
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+#include "mutex.h"
+
+/* The size field of a block holds the size of its payload, which is always a 
+multiple of TLSF_ALIGN, so the lowest bit is free to mark the block free. */
+#define BLOCK_FREE      1u
+#define SIZE_MASK       (~(size_t)(TLSF_ALIGN - 1))
+
+#define SMALL_BLOCK_SIZE  (1u << TLSF_FL_SHIFT)
+#define MAX_BLOCK_SIZE    ((1u << TLSF_FL_MAX) - TLSF_ALIGN)
+
+/**
+* @brief This structure is the header of each block in the heap. Blocks are 
+*   laid out back to back, each payload directly following its header. The 
+*   free list links are only used while the block is free, and so are stored 
+*   in its payload.
+*/
+typedef struct s_TLSFBlock
+{
+    // The block directly before this one in memory, or 0 for the first block.
+    struct s_TLSFBlock* prevPhys;
+    
+    // The size of the payload in bytes, with BLOCK_FREE set if it is free.
+    size_t  size;
+    
+    // The neighbours of the block in its free list.
+    struct s_TLSFBlock* nextFree;
+    struct s_TLSFBlock* prevFree;
+} OS_tlsfBlock_t;
+
+#define BLOCK_OVERHEAD    offsetof(OS_tlsfBlock_t, nextFree)
+#define MIN_BLOCK_SIZE    (sizeof(OS_tlsfBlock_t) - BLOCK_OVERHEAD)
+
+static size_t BlockSize(const OS_tlsfBlock_t* const block)
+{
+    return block->size & SIZE_MASK;
+}
+
+static uint32_t BlockIsFree(const OS_tlsfBlock_t* const block)
+{
+    return block->size & BLOCK_FREE;
+}
+
+static void* BlockPayload(OS_tlsfBlock_t* const block)
+{
+    return (char* )block + BLOCK_OVERHEAD;
+}
+
+static OS_tlsfBlock_t* BlockFromPayload(void* const ptr)
+{
+    return (OS_tlsfBlock_t* )((char* )ptr - BLOCK_OVERHEAD);
+}
+
+/* This function returns the block directly after a block in memory. The last 
+block is followed by a zero sized sentinel that is never free. */
+static OS_tlsfBlock_t* NextPhys(OS_tlsfBlock_t* const block)
+{
+    return (OS_tlsfBlock_t* )((char* )BlockPayload(block) + BlockSize(block));
+}
+
+/* This function returns the index of the most significant set bit. */
+static uint32_t HighBit(const uint32_t x)
+{
+    return 31 - __CLZ(x);
+}
+
+/* This function returns the index of the least significant set bit. */
+static uint32_t LowBit(const uint32_t x)
+{
+    return 31 - __CLZ(x & (0 - x));
+}
+
+/* This function finds the lists a block of the given size is kept in. */
+static void Mapping(const size_t size, uint32_t* const fl, uint32_t* const sl)
+{
+    if (size < SMALL_BLOCK_SIZE)
+    {
+        *fl = 0;
+        *sl = size / (SMALL_BLOCK_SIZE / TLSF_SL_COUNT);
+    }
+    else
+    {
+        uint32_t bit = HighBit(size);
+        *sl = (size >> (bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+        *fl = bit - TLSF_FL_SHIFT + 1;
+    }
+}
+
+/* This function adds a block to the free list for its size. */
+static void InsertFree(OS_tlsf_t* const heap, OS_tlsfBlock_t* const block)
+{
+    uint32_t fl, sl;
+    Mapping(BlockSize(block), &fl, &sl);
+    
+    OS_tlsfBlock_t* head = heap->freeLists[fl][sl];
+    
+    block->size |= BLOCK_FREE;
+    block->prevFree = 0;
+    block->nextFree = head;
+    if (head)
+    {
+        head->prevFree = block;
+    }
+    
+    heap->freeLists[fl][sl] = block;
+    heap->slBitmap[fl] |= 1u << sl;
+    heap->flBitmap |= 1u << fl;
+    heap->nFreeBlocks++;
+}
+
+/* This function removes a block from its free list. */
+static void RemoveFree(OS_tlsf_t* const heap, OS_tlsfBlock_t* const block)
+{
+    uint32_t fl, sl;
+    Mapping(BlockSize(block), &fl, &sl);
+    
+    if (block->prevFree)
+    {
+        block->prevFree->nextFree = block->nextFree;
+    }
+    else
+    {
+        heap->freeLists[fl][sl] = block->nextFree;
+    }
+    
+    if (block->nextFree)
+    {
+        block->nextFree->prevFree = block->prevFree;
+    }
+    
+    // Clear the bitmaps if the list is now empty.
+    if (!heap->freeLists[fl][sl])
+    {
+        heap->slBitmap[fl] &= ~(1u << sl);
+        if (!heap->slBitmap[fl])
+        {
+            heap->flBitmap &= ~(1u << fl);
+        }
+    }
+    
+    block->size &= ~BLOCK_FREE;
+    heap->nFreeBlocks--;
+}
+
+/* This function finds a free block of at least the given size, which must 
+already be rounded up so that every block in its list is large enough. It 
+returns 0 if there is none. */
+static OS_tlsfBlock_t* FindFree(OS_tlsf_t* const heap, const size_t size)
+{
+    uint32_t fl, sl;
+    Mapping(size, &fl, &sl);
+    
+    // Look for a non-empty list of the same first level and a second level at 
+    // least as large, then for any list of a larger first level.
+    uint32_t slMap = heap->slBitmap[fl] & (~0u << sl);
+    if (!slMap)
+    {
+        uint32_t flMap = (fl + 1 < 32) ? heap->flBitmap & (~0u << (fl + 1)) : 0;
+        if (!flMap)
+        {
+            return 0;
+        }
+        
+        fl = LowBit(flMap);
+        slMap = heap->slBitmap[fl];
+    }
+    
+    return heap->freeLists[fl][LowBit(slMap)];
+}
+
+void OS_InitTLSF(OS_tlsf_t* const heap, void* const region, const size_t size)
+{
+    uintptr_t start = ((uintptr_t)region + TLSF_ALIGN - 1) & SIZE_MASK;
+    uintptr_t end = ((uintptr_t)region + size) & SIZE_MASK;
+    
+    ASSERT(end > start + 2 * BLOCK_OVERHEAD + MIN_BLOCK_SIZE);
+    
+    heap->flBitmap = 0;
+    for (uint32_t i = 0; i < TLSF_FL_COUNT; i++)
+    {
+        heap->slBitmap[i] = 0;
+        for (uint32_t j = 0; j < TLSF_SL_COUNT; j++)
+        {
+            heap->freeLists[i][j] = 0;
+        }
+    }
+    
+    heap->usedBytes = 0;
+    heap->peakUsedBytes = 0;
+    heap->nFreeBlocks = 0;
+    heap->nAllocs = 0;
+    heap->nFrees = 0;
+    heap->nFailed = 0;
+    
+    // The whole region is one free block followed by the sentinel.
+    size_t blockSize = (end - start) - 2 * BLOCK_OVERHEAD;
+    if (blockSize > MAX_BLOCK_SIZE)
+    {
+        blockSize = MAX_BLOCK_SIZE;
+    }
+    
+    OS_tlsfBlock_t* block = (OS_tlsfBlock_t* )start;
+    block->prevPhys = 0;
+    block->size = blockSize;
+    
+    OS_tlsfBlock_t* sentinel = NextPhys(block);
+    sentinel->prevPhys = block;
+    sentinel->size = 0;
+    
+    InsertFree(heap, block);
+    heap->totalBytes = blockSize + BLOCK_OVERHEAD;
+    
+    OS_InitMutex(&heap->mux);
+}
+
+void* OS_TLSFMalloc(OS_tlsf_t* const heap, const size_t bytes)
+{
+    if (bytes == 0 || bytes > MAX_BLOCK_SIZE)
+    {
+        return 0;
+    }
+    
+    size_t size = (bytes + TLSF_ALIGN - 1) & SIZE_MASK;
+    if (size < MIN_BLOCK_SIZE)
+    {
+        size = MIN_BLOCK_SIZE;
+    }
+    
+    // Round the size up to the start of the next second level list, so that 
+    // any block found is large enough without searching the list.
+    size_t searchSize = size;
+    if (size >= SMALL_BLOCK_SIZE)
+    {
+        searchSize += (1u << (HighBit(size) - TLSF_SL_LOG2)) - 1;
+    }
+    
+    OS_MutexAquire(&heap->mux);
+    
+    OS_tlsfBlock_t* block = 0;
+    if (searchSize <= MAX_BLOCK_SIZE)
+    {
+        block = FindFree(heap, searchSize);
+    }
+    
+    if (!block)
+    {
+        heap->nFailed++;
+        OS_MutexRelease(&heap->mux);
+        return 0;
+    }
+    
+    RemoveFree(heap, block);
+    
+    // Split off the end of the block if it is large enough to hold another.
+    if (BlockSize(block) >= size + BLOCK_OVERHEAD + MIN_BLOCK_SIZE)
+    {
+        OS_tlsfBlock_t* rest = (OS_tlsfBlock_t* )((char* )BlockPayload(block) + size);
+        rest->prevPhys = block;
+        rest->size = BlockSize(block) - size - BLOCK_OVERHEAD;
+        NextPhys(rest)->prevPhys = rest;
+        
+        block->size = size;
+        InsertFree(heap, rest);
+    }
+    
+    heap->nAllocs++;
+    heap->usedBytes += BlockSize(block) + BLOCK_OVERHEAD;
+    if (heap->usedBytes > heap->peakUsedBytes)
+    {
+        heap->peakUsedBytes = heap->usedBytes;
+    }
+    
+    OS_MutexRelease(&heap->mux);
+    
+    return BlockPayload(block);
+}
+
+void OS_TLSFFree(OS_tlsf_t* const heap, void* const ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    
+    OS_tlsfBlock_t* block = BlockFromPayload(ptr);
+    
+    OS_MutexAquire(&heap->mux);
+    
+    // Catch double frees.
+    ASSERT(!BlockIsFree(block));
+    
+    heap->nFrees++;
+    heap->usedBytes -= BlockSize(block) + BLOCK_OVERHEAD;
+    
+    // Merge with the previous block if it is free.
+    OS_tlsfBlock_t* prev = block->prevPhys;
+    if (prev && BlockIsFree(prev))
+    {
+        RemoveFree(heap, prev);
+        prev->size = BlockSize(prev) + BLOCK_OVERHEAD + BlockSize(block);
+        block = prev;
+        NextPhys(block)->prevPhys = block;
+    }
+    
+    // Merge with the next block if it is free. The sentinel never is.
+    OS_tlsfBlock_t* next = NextPhys(block);
+    if (BlockIsFree(next))
+    {
+        RemoveFree(heap, next);
+        block->size = BlockSize(block) + BLOCK_OVERHEAD + BlockSize(next);
+        NextPhys(block)->prevPhys = block;
+    }
+    
+    InsertFree(heap, block);
+    
+    OS_MutexRelease(&heap->mux);
+}
+
+void OS_TLSFGetStats(OS_tlsf_t* const heap, OS_tlsfStats_t* const stats)
+{
+    OS_MutexAquire(&heap->mux);
+    
+    stats->totalBytes = heap->totalBytes;
+    stats->usedBytes = heap->usedBytes;
+    stats->peakUsedBytes = heap->peakUsedBytes;
+    stats->nFreeBlocks = heap->nFreeBlocks;
+    stats->nAllocs = heap->nAllocs;
+    stats->nFrees = heap->nFrees;
+    stats->nFailed = heap->nFailed;
+    
+    // The largest free block is in the highest non-empty list, but that list 
+    // is not sorted.
+    stats->largestFree = 0;
+    if (heap->flBitmap)
+    {
+        uint32_t fl = HighBit(heap->flBitmap);
+        uint32_t sl = HighBit(heap->slBitmap[fl]);
+        
+        for (OS_tlsfBlock_t* block = heap->freeLists[fl][sl]; block; block = block->nextFree)
+        {
+            if (BlockSize(block) > stats->largestFree)
+            {
+                stats->largestFree = BlockSize(block);
+            }
+        }
+    }
+    
+    // Free memory counts the headers of free blocks, as merging blocks would 
+    // make them available.
+    size_t freeBytes = heap->totalBytes - heap->usedBytes;
+    stats->fragmentation = 0;
+    if (freeBytes)
+    {
+        stats->fragmentation = 100 - (uint32_t)(((uint64_t)(stats->largestFree + BLOCK_OVERHEAD) * 100) / freeBytes);
+    }
+    
+    OS_MutexRelease(&heap->mux);
+}
@@ -0,0 +1,127 @@
+#ifndef TLSF_H
+#define TLSF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mutex.h"
+
+/*
+A Two-Level Segregated Fit heap allocates blocks of any size from a single 
+region of memory in bounded time. Free blocks are kept in lists segregated by 
+size: the first level splits sizes into powers of two, and the second level 
+splits each power of two into TLSF_SL_COUNT equal ranges. A bitmap of which 
+lists are not empty is kept for each level, so a list holding a large enough 
+block is found with two count leading zeros instructions rather than a search. 
+A freed block is merged with its free neighbours immediately, so the heap never
+holds two adjacent free blocks.
+*/
+
+// The log2 of the number of second level lists per first level list.
+#define TLSF_SL_LOG2       4
+#define TLSF_SL_COUNT      (1 << TLSF_SL_LOG2)
+
+// Every allocation is aligned to, and a multiple of, TLSF_ALIGN bytes.
+#define TLSF_ALIGN_LOG2    3
+#define TLSF_ALIGN         (1 << TLSF_ALIGN_LOG2)
+
+// Blocks smaller than this are all kept in the first first level list, which 
+// is split linearly.
+#define TLSF_FL_SHIFT      (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+
+// Blocks must be smaller than 2^TLSF_FL_MAX bytes.
+#define TLSF_FL_MAX        20
+#define TLSF_FL_COUNT      (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+struct s_TLSFBlock;
+
+/**
+* @brief This structure holds the usage statistics of a heap.
+*/
+typedef struct s_TLSFStats
+{
+    // The bytes available to allocations when the heap was initialised, and 
+    // the bytes currently and at most allocated, including block headers.
+    size_t   totalBytes;
+    size_t   usedBytes;
+    size_t   peakUsedBytes;
+    
+    // The number of free blocks, and the size of the largest.
+    uint32_t nFreeBlocks;
+    size_t   largestFree;
+    
+    // The percentage of free memory that is not in the largest free block. 0 
+    // means all free memory is in one block.
+    uint32_t fragmentation;
+    
+    uint32_t nAllocs;
+    uint32_t nFrees;
+    
+    // Allocations that failed because no free block was large enough.
+    uint32_t nFailed;
+} OS_tlsfStats_t;
+
+/**
+* @brief This structure contains a heap. It must be initialised with 
+*   OS_InitTLSF() before use.
+*/
+typedef struct s_TLSF
+{
+    // Bit i is set if any of the second level lists of first level list i are
+    // not empty.
+    uint32_t  flBitmap;
+    
+    // Bit j of slBitmap[i] is set if freeLists[i][j] is not empty.
+    uint32_t  slBitmap[TLSF_FL_COUNT];
+    
+    struct s_TLSFBlock*  freeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    
+    size_t    totalBytes;
+    size_t    usedBytes;
+    size_t    peakUsedBytes;
+    uint32_t  nFreeBlocks;
+    uint32_t  nAllocs;
+    uint32_t  nFrees;
+    uint32_t  nFailed;
+    
+    // Mutex lock to prevent simultaneous access.
+    OS_mutex_t  mux;
+} OS_tlsf_t;
+
+/**
+* @brief Initialise a heap over a region of memory.
+* @param heap Pointer to the heap to initialise.
+* @param region The memory the heap allocates from, which must be statically 
+*   allocated. Any of it beyond the largest block size is left unused.
+* @param size The size of the region in bytes.
+*/
+void OS_InitTLSF(OS_tlsf_t* const heap, void* const region, const size_t size);
+
+/**
+* @brief Allocate a block of at least the given size from a heap, in bounded 
+*   time. This must only be called by a task.
+* @param heap Pointer to the heap.
+* @param bytes The size required.
+* @return Pointer to the block, aligned to TLSF_ALIGN bytes.
+* @return 0 if there is no free block large enough, or bytes is 0.
+*/
+void* OS_TLSFMalloc(OS_tlsf_t* const heap, const size_t bytes);
+
+/**
+* @brief Free a block allocated with OS_TLSFMalloc(), in bounded time. This must
+*   only be called by a task.
+* @param heap Pointer to the heap the block was allocated from.
+* @param ptr Pointer to the block. If this is 0, the function does nothing.
+*/
+void OS_TLSFFree(OS_tlsf_t* const heap, void* const ptr);
+
+/**
+* @brief Get the usage and fragmentation statistics of a heap. Finding the 
+*   largest free block searches a single free list, so unlike allocation this
+*   is not bounded in time. This must only be called by a task.
+* @param heap Pointer to the heap.
+* @param stats Filled in with the statistics.
+*/
+void OS_TLSFGetStats(OS_tlsf_t* const heap, OS_tlsfStats_t* const stats);
+
+#endif  // TLSF_H
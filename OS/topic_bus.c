@@ -0,0 +1,180 @@
+#include "topic_bus.h"
+
+#include <string.h>
+#include "cmsis_armcc.h"
+
+#include "os.h"
+#include "os_internal.h"
+
+void OS_InitTopic(OS_topic_t* const topic, 
+                    uint8_t* const storage, 
+                    const size_t slotSz,
+                    const uint32_t nSlots)
+{
+    ASSERT(nSlots > 0 && nSlots <= TOPIC_MAX_SLOTS);
+    
+    topic->storage = storage;
+    topic->slotSz = slotSz;
+    topic->nSlots = nSlots;
+    
+    for (uint32_t i = 0; i < nSlots; i++)
+    {
+        topic->slots[i].refCount = 0;
+        topic->slots[i].seq = 0;
+        topic->slots[i].len = 0;
+    }
+    
+    topic->seq = 0;
+    topic->nSubscribers = 0;
+    
+    OS_InitMutex(&topic->mux);
+    OS_InitTCBPriorityQueue(&topic->_subscribersQueue, topic->_subscribers, MAX_TASKS, TCBPQ_ORDER_BY_PRIORITY);
+    OS_InitTCBPriorityQueue(&topic->_publishersQueue, topic->_publishers, MAX_TASKS, TCBPQ_ORDER_BY_PRIORITY);
+}
+
+/* This function drops one reference to the slot holding a sample, and returns
+1 if it was the last. */
+static uint32_t DropRef(OS_topic_t* const topic, const uint32_t seq)
+{
+    OS_topicSlot_t* slot = &topic->slots[seq % topic->nSlots];
+    uint32_t atomRefCount;
+    
+    do
+    {
+        atomRefCount = __LDREXW((uint32_t* )&slot->refCount);
+        atomRefCount--;
+    } while (__STREXW(atomRefCount, (uint32_t* )&slot->refCount));
+    
+    return atomRefCount == 0;
+}
+
+void OS_TopicSubscribe(OS_topic_t* const topic, OS_subscriber_t* const sub)
+{
+    OS_MutexAquire(&topic->mux);
+    
+    sub->topic = topic;
+    sub->nextSeq = topic->seq + 1;
+    topic->nSubscribers++;
+    
+    OS_MutexRelease(&topic->mux);
+}
+
+void OS_TopicUnsubscribe(OS_subscriber_t* const sub)
+{
+    OS_topic_t* topic = sub->topic;
+    uint32_t freed = 0;
+    
+    OS_MutexAquire(&topic->mux);
+    
+    // Every sample published since the subscriber's last read still holds a 
+    // reference for it.
+    for (uint32_t seq = sub->nextSeq; seq <= topic->seq; seq++)
+    {
+        freed |= DropRef(topic, seq);
+    }
+    
+    topic->nSubscribers--;
+    sub->topic = 0;
+    
+    OS_MutexRelease(&topic->mux);
+    
+    if (freed)
+    {
+        OS_Notify(&topic->_publishersQueue);
+    }
+}
+
+void OS_TopicPublish(OS_topic_t* const topic, 
+                       const void* const data, 
+                       const size_t len)
+{
+    ASSERT(len <= topic->slotSz);
+    
+    OS_MutexAquire(&topic->mux);
+    
+    uint32_t seq = topic->seq + 1;
+    uint32_t index = seq % topic->nSlots;
+    OS_topicSlot_t* slot = &topic->slots[index];
+    
+    while (slot->refCount)
+    {
+        // The slowest subscriber has not yet released the sample in this slot.
+        // The check code is taken after releasing the mutex, as releasing it 
+        // changes the check code.
+        OS_MutexRelease(&topic->mux);
+        
+        uint32_t checkCode = OS_GetCheckCode();
+        if (slot->refCount)
+        {
+            OS_Wait(&topic->_publishersQueue, checkCode);
+        }
+        
+        OS_MutexAquire(&topic->mux);
+    }
+    
+    memcpy(&topic->storage[index * topic->slotSz], data, len);
+    slot->len = len;
+    slot->seq = seq;
+    slot->refCount = topic->nSubscribers;
+    
+    // The sample must be in place before subscribers can see the new sequence
+    // number.
+    __DMB();
+    topic->seq = seq;
+    
+    OS_MutexRelease(&topic->mux);
+    
+    // A subscriber about to wait has its wait aborted by the change to the 
+    // check code made when the mutex was released.
+    if (topic->_subscribersQueue.length)
+    {
+        OS_NotifyAll(&topic->_subscribersQueue);
+    }
+}
+
+const void* OS_TopicAcquire(OS_subscriber_t* const sub, size_t* const len)
+{
+    OS_topic_t* topic = sub->topic;
+    
+    while (sub->nextSeq > topic->seq)
+    {
+        uint32_t checkCode = OS_GetCheckCode();
+        if (sub->nextSeq > topic->seq)
+        {
+            OS_Wait(&topic->_subscribersQueue, checkCode);
+        }
+    }
+    
+    __DMB();
+    
+    uint32_t index = sub->nextSeq % topic->nSlots;
+    *len = topic->slots[index].len;
+    
+    return &topic->storage[index * topic->slotSz];
+}
+
+void OS_TopicRelease(OS_subscriber_t* const sub)
+{
+    OS_topic_t* topic = sub->topic;
+    
+    // The last subscriber to release a slot always notifies, even if no 
+    // publisher is waiting yet, so that the change to the check code aborts 
+    // the wait of a publisher that is about to wait for this slot.
+    if (DropRef(topic, sub->nextSeq++))
+    {
+        OS_Notify(&topic->_publishersQueue);
+    }
+}
+
+size_t OS_TopicReceive(OS_subscriber_t* const sub, 
+                         void* const data, 
+                         const size_t maxLen)
+{
+    size_t len;
+    const void* sample = OS_TopicAcquire(sub, &len);
+    
+    memcpy(data, sample, (len < maxLen) ? len : maxLen);
+    OS_TopicRelease(sub);
+    
+    return len;
+}
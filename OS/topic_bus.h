@@ -0,0 +1,147 @@
+#ifndef TOPIC_BUS_H
+#define TOPIC_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "task.h"
+#include "mutex.h"
+#include "tcb_priority_queue.h"
+
+#define TOPIC_MAX_SLOTS 8
+
+/*
+A topic carries published samples to every task that has subscribed to it. A 
+sample is copied once, into a slot of the topic, and the slot holds a reference
+for each subscriber. Each subscriber reads the samples in the order they were 
+published, and the slot is only reused once every subscriber has released it. 
+Publishing wakes every waiting subscriber in a single kernel call.
+
+If a subscriber falls behind so that every slot is still referenced, the 
+publisher waits for it. 
+*/
+
+/**
+* @brief This structure contains the state of a single slot in a topic.
+*/
+typedef struct s_TopicSlot
+{
+    // The number of subscribers that have yet to release the slot.
+    volatile uint32_t  refCount;
+    
+    // The sequence number of the sample in the slot, and its length in bytes.
+    uint32_t  seq;
+    size_t    len;
+} OS_topicSlot_t;
+
+/**
+* @brief This structure contains a single topic. It must be initialised with 
+*   OS_InitTopic() before use.
+*/
+typedef struct s_Topic
+{
+    // The storage for the samples, nSlots slots of slotSz bytes each.
+    uint8_t*        storage;
+    size_t          slotSz;
+    uint32_t        nSlots;
+    OS_topicSlot_t  slots[TOPIC_MAX_SLOTS];
+    
+    // The sequence number of the latest sample. Sample n is held in slot 
+    // n % nSlots. Sequence numbers start at 1, so 0 means nothing has been 
+    // published yet.
+    volatile uint32_t  seq;
+    
+    volatile uint32_t  nSubscribers;
+    
+    // Mutex lock to serialise publishers and changes to the subscribers.
+    OS_mutex_t  mux;
+    
+    // Subscribers waiting for a sample, and publishers waiting for a slot.
+    OS_tcbPriorityQueue_t  _subscribersQueue;
+    OS_TCB_t*              _subscribers[MAX_TASKS];
+    OS_tcbPriorityQueue_t  _publishersQueue;
+    OS_TCB_t*              _publishers[MAX_TASKS];
+} OS_topic_t;
+
+/**
+* @brief This structure is a subscription to a topic, held by the subscribing 
+*   task. Its fields are set by OS_TopicSubscribe().
+*/
+typedef struct s_Subscriber
+{
+    OS_topic_t*  topic;
+    
+    // The sequence number of the next sample to read.
+    uint32_t     nextSeq;
+} OS_subscriber_t;
+
+/**
+* @brief Initialise a topic.
+* @param topic Pointer to the topic to initialise.
+* @param storage Pointer to a statically allocated array of nSlots * slotSz 
+*   bytes.
+* @param slotSz The largest sample, in bytes.
+* @param nSlots The number of samples that can be held at once, from 1 to 
+*   TOPIC_MAX_SLOTS.
+*/
+void OS_InitTopic(OS_topic_t* const topic, 
+                    uint8_t* const storage, 
+                    const size_t slotSz,
+                    const uint32_t nSlots);
+
+/**
+* @brief Subscribe to a topic. The subscriber receives every sample published 
+*   from now on.
+* @param topic Pointer to the topic.
+* @param sub Pointer to the subscription, which must remain valid until 
+*   OS_TopicUnsubscribe() is called.
+*/
+void OS_TopicSubscribe(OS_topic_t* const topic, OS_subscriber_t* const sub);
+
+/**
+* @brief Cancel a subscription, releasing every sample it has not read.
+* @param sub Pointer to the subscription.
+*/
+void OS_TopicUnsubscribe(OS_subscriber_t* const sub);
+
+/**
+* @brief Publish a sample to every subscriber of a topic. The sample is copied 
+*   into the topic once. If every slot is still referenced, the calling task 
+*   waits until one is released.
+* @param topic Pointer to the topic.
+* @param data Pointer to the sample.
+* @param len The length of the sample in bytes, at most the topic's slotSz.
+*/
+void OS_TopicPublish(OS_topic_t* const topic, 
+                       const void* const data, 
+                       const size_t len);
+
+/**
+* @brief Get the next sample for a subscription without copying it, waiting for
+*   one if none has been published. The sample must be released with 
+*   OS_TopicRelease() before the next one is acquired.
+* @param sub Pointer to the subscription.
+* @param len Pointer to where the length of the sample will be written.
+* @return Pointer to the sample, which must not be modified.
+*/
+const void* OS_TopicAcquire(OS_subscriber_t* const sub, size_t* const len);
+
+/**
+* @brief Release the sample last acquired with OS_TopicAcquire().
+* @param sub Pointer to the subscription.
+*/
+void OS_TopicRelease(OS_subscriber_t* const sub);
+
+/**
+* @brief Copy the next sample for a subscription and release it, waiting for one
+*   if none has been published.
+* @param sub Pointer to the subscription.
+* @param data Pointer to where the sample will be copied.
+* @param maxLen The size of data in bytes. Any more of the sample is discarded.
+* @return The length of the sample in bytes.
+*/
+size_t OS_TopicReceive(OS_subscriber_t* const sub, 
+                         void* const data, 
+                         const size_t maxLen);
+
+#endif  // TOPIC_BUS_H